@@ -0,0 +1,237 @@
+#include "asset_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+const uint32_t CACHE_MAGIC = 0x48434341; // "ACCH"
+const uint32_t CACHE_VERSION = 1;
+
+struct CacheEntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+    uint64_t hash;
+};
+
+static uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+
+    return h;
+}
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed)
+{
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    const uint8_t* p = (const uint8_t*)data;
+
+    // four independent lanes keep the multiplies pipelined on large inputs
+    uint64_t h[4] = { seed, seed ^ m, seed + m, seed - m };
+
+    while (size >= 32) {
+        for (int i = 0; i < 4; i++) {
+            uint64_t k;
+            memcpy(&k, p + i * 8, sizeof(k));
+            h[i] = (h[i] ^ (k * m)) * 0xff51afd7ed558ccdull;
+            h[i] ^= h[i] >> 31;
+        }
+
+        p += 32;
+        size -= 32;
+    }
+
+    uint64_t result = mix(h[0]) ^ (mix(h[1]) * 3) ^ (mix(h[2]) * 5) ^ (mix(h[3]) * 7);
+
+    while (size > 0) {
+        uint64_t k = 0;
+        size_t n = std::min(size, sizeof(k));
+        memcpy(&k, p, n);
+
+        result = mix(result ^ (k * m) ^ n);
+        p += n;
+        size -= n;
+    }
+
+    return mix(result);
+}
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (ptr == MAP_FAILED)
+        return false;
+
+    m_data = (const uint8_t*)ptr;
+    m_size = (size_t)st.st_size;
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+        munmap((void*)m_data, m_size);
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+AssetCache::AssetCache(std::string d, uint64_t max) : directory(d), max_bytes(max)
+{
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+}
+
+size_t AssetCache::payload_offset()
+{
+    return sizeof(CacheEntryHeader);
+}
+
+std::string AssetCache::entry_path(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+
+    return (fs::path(directory) / name).string();
+}
+
+bool AssetCache::load(uint64_t key, MappedFile& file)
+{
+    std::string path = entry_path(key);
+
+    if (!file.open(path))
+        return false;
+
+    CacheEntryHeader header;
+    bool valid = file.size() >= sizeof(header);
+
+    if (valid) {
+        memcpy(&header, file.data(), sizeof(header));
+        valid = header.magic == CACHE_MAGIC && header.version == CACHE_VERSION && header.key == key
+            && header.size == file.size() - sizeof(header)
+            && header.hash == hash_bytes(file.data() + sizeof(header), header.size, key);
+    }
+
+    std::error_code ec;
+
+    if (!valid) {
+        file.close();
+        fs::remove(path, ec);
+        return false;
+    }
+
+    // refresh for lru eviction
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+    return true;
+}
+
+bool AssetCache::store(uint64_t key, const void* data, size_t size)
+{
+    std::string path = entry_path(key);
+    std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+
+    CacheEntryHeader header = { CACHE_MAGIC, CACHE_VERSION, key, size, hash_bytes(data, size, key) };
+
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (!f)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+        && (size == 0 || fwrite(data, size, 1, f) == 1);
+
+    ok = fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+
+    std::error_code ec;
+
+    if (ok)
+        fs::rename(tmp_path, path, ec);
+
+    if (!ok || ec) {
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+
+    evict(path);
+
+    return true;
+}
+
+void AssetCache::evict(const std::string& keep)
+{
+    struct Entry {
+        fs::path path;
+        fs::file_time_type time;
+        uint64_t size;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+
+    for (const fs::directory_entry& e : fs::directory_iterator(directory, ec)) {
+        if (!e.is_regular_file(ec) || e.path().extension() != ".bin" || e.path() == keep)
+            continue;
+
+        Entry entry = { e.path(), e.last_write_time(ec), e.file_size(ec) };
+        total += entry.size;
+        entries.push_back(entry);
+    }
+
+    total += fs::file_size(keep, ec);
+
+    if (total <= max_bytes)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.time < b.time;
+    });
+
+    for (const Entry& e : entries) {
+        if (total <= max_bytes)
+            break;
+
+        if (fs::remove(e.path, ec))
+            total -= e.size;
+    }
+}
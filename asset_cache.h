@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed);
+
+// read only mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+};
+
+// On disk cache of processed assets, keyed by a hash of the source bytes
+// and processing parameters. Entries are written to a temporary file and
+// renamed into place, so readers never see partial writes. Hits refresh
+// the file time, and the oldest entries are evicted once the directory
+// grows past max_bytes.
+class AssetCache
+{
+public:
+    AssetCache(std::string directory, uint64_t max_bytes);
+
+    // maps the entry payload, file.data() + payload_offset()
+    bool load(uint64_t key, MappedFile& file);
+    bool store(uint64_t key, const void* data, size_t size);
+
+    static size_t payload_offset();
+
+private:
+    std::string entry_path(uint64_t key);
+    // never evicts keep, the entry just written
+    void evict(const std::string& keep);
+
+    std::string directory;
+    uint64_t max_bytes;
+};
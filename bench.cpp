@@ -0,0 +1,1783 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/euler_angles.hpp>
+
+#include "asset_cache.h"
+#include "frame_limiter.h"
+#include "index_codec.h"
+#include "input_log.h"
+#include "job_system.h"
+#include "mesh_blob.h"
+#include "multiview.h"
+#include "profiler.h"
+#include "render_types.h"
+#include "residency.h"
+#include "resource_manager.h"
+#include "resolution_controller.h"
+#include "scene.h"
+#include "simplify.h"
+#include "simulation.h"
+#include "tlsf.h"
+
+#include "input_manager.h"
+#include "camera.h"
+#include "camera_batch.h"
+
+// the app's window
+#define WINDOW_WIDTH 800
+#define WINDOW_HEIGHT 600
+
+// grid x grid quads centred on the origin in the xz plane, clockwise seen
+// from above, with hills of up to height
+static Mesh grid_mesh(int grid, float size, float height)
+{
+    Mesh mesh;
+
+    for (int z = 0; z <= grid; z++) {
+        for (int x = 0; x <= grid; x++) {
+            float u = (float)x / grid, v = (float)z / grid;
+            float y = height * std::sin(u * 12.0f) * std::cos(v * 9.0f);
+            mesh.vertices.push_back({ { (u - 0.5f) * size, y, (v - 0.5f) * size }, { u, v, 1.0f } });
+        }
+    }
+
+    for (int z = 0; z < grid; z++) {
+        for (int x = 0; x < grid; x++) {
+            uint32_t i = z * (grid + 1) + x;
+            mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + grid + 1, i + 1, i + grid + 2, i + grid + 1 });
+        }
+    }
+
+    return mesh;
+}
+
+// Steps the same held input through the fixed timestep at several frame
+// rates, steady and uneven, and compares the state rendered after the
+// same amount of time with one stepped at exactly the simulation rate.
+// Motion must not depend on how often frames come.
+static int run_timestep_test()
+{
+    const double DURATION = 2.0;
+    const double FRAME_RATES[] = { 24.0, 30.0, 60.0, 144.0, 240.0, 1000.0 };
+    const uint32_t HELD = ACTION_FORWARD | ACTION_ROTATE_LEFT;
+    // metres and radians
+    const double TOLERANCE = 1e-3;
+
+    // the interpolated state after DURATION seconds of frames
+    auto run = [&](const std::function<double()>& frame_time) {
+        SimState current;
+        current.triangle.translate = glm::dvec3(0.0);
+        current.triangle.rotate = glm::vec3(0.0f);
+        current.triangle.scale = glm::vec3(1.0f);
+        SimState previous = current;
+
+        double elapsed = 0.0;
+        double accumulator = 0.0;
+
+        while (elapsed < DURATION) {
+            double delta_time = std::min(frame_time(), DURATION - elapsed);
+            elapsed += delta_time;
+
+            int steps = fixed_steps(accumulator, delta_time);
+            for (int i = 0; i < steps; i++)
+                simulation_step(previous, current, HELD);
+        }
+
+        return previous.interpolate(current, (float)(accumulator / SIM_TIMESTEP));
+    };
+
+    SimState reference = run([] { return SIM_TIMESTEP; });
+    bool ok = true;
+
+    auto compare = [&](const char* name, const SimState& state) {
+        double position_error = glm::length(state.camera.position() - reference.camera.position());
+        double rotation_error = std::abs(state.triangle.rotate.z - reference.triangle.rotate.z);
+
+        std::cout << "timestep, " << name << ": camera off by " << position_error << " m, rotation off by "
+                  << rotation_error << " rad\n";
+
+        ok = ok && position_error < TOLERANCE && rotation_error < TOLERANCE;
+    };
+
+    for (double fps : FRAME_RATES) {
+        std::string name = std::to_string((int)fps) + " fps";
+        compare(name.c_str(), run([fps] { return 1.0 / fps; }));
+    }
+
+    // uneven frames, none long enough to hit the catch up limit
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> frame_ms(2.0, 50.0);
+    compare("uneven 2-50 ms frames", run([&] { return frame_ms(rng) / 1000.0; }));
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Pushes bursts of synthetic key events from another thread while the
+// main thread consumes them at a fixed frame rate, and reports how long
+// they waited. Needs only the SDL event subsystem, so it also runs
+// headless (SDL_VIDEODRIVER=dummy).
+static int run_input_latency_test(bool watch)
+{
+    const int BURSTS = 200;
+    const int BURST_SIZE = 64;
+    const auto FRAME_TIME = std::chrono::milliseconds(16);
+
+    if (SDL_Init(SDL_INIT_EVENTS) != 0) {
+        std::cerr << "Failed to init SDL events: " << SDL_GetError() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    InputManager& input = InputManager::instance();
+    input.track_arrivals(true);
+    if (watch)
+        input.enable_event_watch();
+
+    std::atomic<bool> done{false};
+    std::thread injector([&done] {
+        std::mt19937 rng(1);
+        std::uniform_int_distribution<int> pause_ms(0, 40);
+
+        for (int b = 0; b < BURSTS; b++) {
+            for (int i = 0; i < BURST_SIZE; i++) {
+                SDL_Event event = {};
+                event.type = i & 1 ? SDL_KEYUP : SDL_KEYDOWN;
+                event.key.keysym.scancode = (SDL_Scancode)(SDL_SCANCODE_A + i / 2 % 26);
+                SDL_PushEvent(&event);
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(pause_ms(rng)));
+        }
+
+        done = true;
+    });
+
+    size_t consumed = 0;
+    std::vector<uint64_t> arrivals;
+    std::vector<uint64_t> latencies;
+
+    auto consume = [&] {
+        input.update();
+        consumed += input.frame_events().size();
+
+        uint64_t now = Profiler::now_ns();
+        arrivals.clear();
+        input.take_arrivals(arrivals);
+
+        for (uint64_t arrival : arrivals)
+            latencies.push_back(now - arrival);
+    };
+
+    while (!done) {
+        consume();
+        std::this_thread::sleep_for(FRAME_TIME);
+    }
+
+    injector.join();
+    consume();
+
+    input.disable_event_watch();
+    SDL_Quit();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    // without the watch events are only timestamped when polled
+    std::cout << "input latency (" << (watch ? "event watch" : "polling") << "): "
+              << BURSTS * BURST_SIZE << " injected, " << consumed << " consumed, p50 "
+              << percentile_ms(latencies, 0.5) << " ms p90 " << percentile_ms(latencies, 0.9) << " ms p99 "
+              << percentile_ms(latencies, 0.99) << " ms max " << percentile_ms(latencies, 1.0) << " ms\n";
+
+    return consumed == (size_t)(BURSTS * BURST_SIZE) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Records a scripted session of key presses with uneven frame times to
+// an input log, replays the log and checks the app's view hash, over the
+// MVPs and LOD distance of every frame so far, agrees after each frame.
+// Also checks a log with an impossible scancode is rejected. Runs
+// headless like the latency test.
+static int run_replay_test()
+{
+    const int FRAMES = 600;
+    const SDL_Scancode KEYS[] = { KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT };
+
+    if (SDL_Init(SDL_INIT_EVENTS) != 0) {
+        std::cerr << "Failed to init SDL events: " << SDL_GetError() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    char path[] = "/tmp/input_logXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        std::cerr << "Failed to create a temporary input log\n";
+        SDL_Quit();
+        return EXIT_FAILURE;
+    }
+    close(fd);
+
+    InputManager& input = InputManager::instance();
+    input.track_arrivals(false);
+
+    auto push_key = [](SDL_Scancode key, bool down) {
+        SDL_Event event = {};
+        event.type = down ? SDL_KEYDOWN : SDL_KEYUP;
+        event.key.keysym.scancode = key;
+        SDL_PushEvent(&event);
+    };
+
+    // recording and replay both start with nothing held
+    auto release_all = [&] {
+        for (SDL_Scancode key : KEYS)
+            push_key(key, false);
+        input.update();
+    };
+
+    // one frame of the app's single threaded loop with --views 2, from
+    // the app's starting state, hashing the view it would render
+    struct Session {
+        SimState previous, current;
+        double accumulator = 0.0;
+        uint64_t view_hash = 0;
+        std::vector<uint64_t> hashes;
+
+        Session()
+        {
+            current.triangle.translate = glm::dvec3(0.0, 0.0, 0.0);
+            current.triangle.scale = glm::vec3(1.0f, 1.0f, 1.0f);
+            current.triangle.rotate = glm::vec3(0.0f, 0.0f, glm::half_pi<float>());
+            current.camera.set_projection((float)WINDOW_WIDTH / 2 / (float)WINDOW_HEIGHT, 0.1f, 1000.0f);
+            previous = current;
+        }
+
+        void frame(InputManager& input, float delta_time)
+        {
+            int steps = fixed_steps(accumulator, delta_time);
+            for (int i = 0; i < steps; i++)
+                simulation_step(previous, current, held_actions(input));
+
+            SimState s = previous.interpolate(current, (float)(accumulator / SIM_TIMESTEP));
+            view_hash = hash_frame_view(frame_view(s, 2), view_hash);
+            hashes.push_back(view_hash);
+        }
+    };
+
+    release_all();
+
+    Session recorded;
+    InputLogWriter writer;
+    bool ok = writer.open(path);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> frame_ms(4.0f, 40.0f);
+    std::uniform_int_distribution<int> key(0, 3);
+    std::bernoulli_distribution change(0.2);
+    std::bernoulli_distribution press(0.5);
+
+    for (int f = 0; ok && f < FRAMES; f++) {
+        // presses and releases, sometimes both within a frame
+        while (change(rng))
+            push_key(KEYS[key(rng)], press(rng));
+
+        float delta_time = frame_ms(rng) / 1000.0f;
+        input.update();
+        writer.write({ (uint64_t)f, delta_time, input.frame_events() });
+        recorded.frame(input, delta_time);
+    }
+
+    ok = writer.close() && ok;
+    release_all();
+
+    std::vector<InputFrame> frames;
+    ok = ok && read_input_log(path, frames) && frames.size() == FRAMES;
+
+    Session replayed;
+    for (const InputFrame& frame : frames) {
+        input.replay(frame.events);
+        replayed.frame(input, frame.delta_time);
+    }
+
+    size_t mismatch = 0;
+    while (mismatch < replayed.hashes.size() && replayed.hashes[mismatch] == recorded.hashes[mismatch])
+        mismatch++;
+
+    bool identical = ok && mismatch == (size_t)FRAMES;
+    release_all();
+
+    // a key past the end of the key state must not load
+    InputLogWriter bad;
+    InputEvent event = {};
+    event.type = InputEvent::Type::KeyDown;
+    event.scancode = (SDL_Scancode)SDL_NUM_SCANCODES;
+    bool rejected = bad.open(path);
+    bad.write({ 0, 0.016f, { event } });
+    rejected = bad.close() && rejected && !read_input_log(path, frames);
+
+    unlink(path);
+    SDL_Quit();
+
+    std::cout << "replay: " << FRAMES << " frames recorded, ";
+    if (identical)
+        std::cout << "view hash " << std::hex << replayed.view_hash << std::dec << " on both";
+    else if (!ok)
+        std::cout << "log failed to write or read";
+    else
+        std::cout << "first mismatch at frame " << mismatch;
+    std::cout << ", bad scancode " << (rejected ? "rejected" : "accepted") << "\n";
+
+    return identical && rejected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Runs the frame limiter against frames of random length, a few of them
+// overrunning on purpose, and reports how close to its deadline each
+// frame started and how much CPU the waiting took.
+static int run_frame_pacing_test(double fps)
+{
+    using clock = FrameLimiter::clock;
+
+    const int FRAMES = 600;
+    const int OVERRUN_EVERY = 100;
+
+    auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / fps));
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> work_percent(0, 50);
+
+    FrameLimiter limiter;
+    limiter.init(fps);
+    limiter.wait();
+
+    clock::time_point start = clock::now();
+    clock::time_point deadline = start;
+    std::vector<uint64_t> late;
+    int overruns = 0;
+
+    rusage usage_start;
+    getrusage(RUSAGE_SELF, &usage_start);
+
+    for (int i = 1; i <= FRAMES; i++) {
+        // stands in for the frame's work, sleeping like a GPU wait would
+        bool overrun = i % OVERRUN_EVERY == 0;
+        std::this_thread::sleep_for(overrun ? period * 3 / 2 : period * work_percent(rng) / 100);
+        overruns += overrun;
+
+        limiter.wait();
+        clock::time_point now = clock::now();
+
+        // a missed frame restarts the schedule, it has no deadline to hit
+        if (overrun) {
+            deadline = now;
+            continue;
+        }
+
+        deadline += period;
+        // the limiter's own deadline is a moment earlier than this one
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - deadline).count();
+        late.push_back((uint64_t)std::max<int64_t>(ns, 0));
+    }
+
+    std::chrono::duration<double> elapsed = clock::now() - start;
+
+    rusage usage_end;
+    getrusage(RUSAGE_SELF, &usage_end);
+
+    double cpu = cpu_seconds(usage_start, usage_end);
+
+    std::sort(late.begin(), late.end());
+    FrameLimiter::Stats stats = limiter.stats();
+
+    std::cout << "frame pacing at " << fps << " fps: " << FRAMES << " frames in " << elapsed.count() << " s, "
+              << stats.missed << " missed of " << overruns << " overrun, start after deadline p50 "
+              << percentile_ms(late, 0.5) << " ms p99 " << percentile_ms(late, 0.99) << " ms max "
+              << percentile_ms(late, 1.0) << " ms, frame time stddev " << std::sqrt(stats.variance_ms)
+              << " ms, cpu " << 100.0 * cpu / elapsed.count() << "%\n";
+
+    return stats.missed == (uint64_t)overruns && percentile_ms(late, 0.99) < 0.5 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Shades a synthetic fill bound scene on the CPU, cost proportional to
+// the pixel count, with the resolution controller holding a frame time
+// target. Halfway through the per pixel cost drops to a third and the
+// scale should come back up to full.
+static int run_resolution_test()
+{
+    using clock = std::chrono::steady_clock;
+
+    const int WIDTH = 1280;
+    const int HEIGHT = 720;
+    const int PHASE_FRAMES = 300;
+    // the later part of a phase, once the controller has settled
+    const int SETTLED_FRAMES = 150;
+
+    std::vector<uint32_t> pixels(WIDTH * HEIGHT);
+
+    auto shade = [&pixels](float scale, int work) {
+        auto start = clock::now();
+        int w = (int)(WIDTH * scale);
+        int h = (int)(HEIGHT * scale);
+
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                float v = x * 0.01f + y * 0.02f;
+                for (int i = 0; i < work; i++)
+                    v = std::sin(v) * 0.9f + 0.1f;
+                pixels[y * WIDTH + x] = (uint32_t)(v * 255.0f);
+            }
+        }
+
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    };
+
+    // enough work per pixel for a full resolution frame of roughly 20 ms
+    int work = 4;
+    double full_ms = shade(1.0f, work);
+    work = std::max(3, (int)(work * 20.0 / full_ms));
+    full_ms = shade(1.0f, work);
+
+    double target_ms = full_ms * 0.5;
+    ResolutionController controller;
+    controller.init(target_ms);
+
+    bool ok = true;
+
+    for (int phase = 0; phase < 2; phase++) {
+        int phase_work = phase == 0 ? work : work / 3;
+        double settled_total = 0.0;
+        uint32_t changes_before = 0;
+
+        for (int i = 0; i < PHASE_FRAMES; i++) {
+            if (i == PHASE_FRAMES - SETTLED_FRAMES)
+                changes_before = controller.changes();
+
+            double ms = shade(controller.scale(), phase_work);
+
+            if (i >= PHASE_FRAMES - SETTLED_FRAMES)
+                settled_total += ms;
+
+            controller.update(ms);
+        }
+
+        double settled_ms = settled_total / SETTLED_FRAMES;
+        uint32_t settled_changes = controller.changes() - changes_before;
+
+        std::cout << "dynamic resolution, " << (phase == 0 ? "heavy" : "light") << " scene: target "
+                  << target_ms << " ms, settled at " << settled_ms << " ms, scale " << controller.scale()
+                  << ", " << settled_changes << " changes while settled, " << controller.changes()
+                  << " in total\n";
+
+        // holding means staying under the target without flapping, a
+        // light scene may sit under the band at full scale
+        ok = ok && settled_ms < target_ms * 1.1 && settled_changes <= 2;
+        if (phase == 0)
+            ok = ok && settled_ms > target_ms * 0.7;
+        else
+            ok = ok && controller.scale() == 1.0f;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Per frame camera cost: one camera that moves every frame, one that
+// doesn't and hits the cache, and many cameras updated one by one or as
+// a batch.
+static int run_camera_benchmark()
+{
+    using clock = std::chrono::steady_clock;
+
+    const int FRAMES = 10000;
+    const size_t CAMERAS = 4096;
+    const int BATCH_FRAMES = 200;
+
+    auto us_per = [](clock::duration d, int count) {
+        return std::chrono::duration<double, std::micro>(d).count() / count;
+    };
+
+    float sink = 0.0f;
+    Camera camera;
+
+    auto start = clock::now();
+    for (int i = 0; i < FRAMES; i++) {
+        camera.process_keyboard(i & 1 ? CameraDirection::RIGHT : CameraDirection::FORWARD, 0.001f);
+        sink += camera.view_projection()[3][2];
+    }
+    double moving_us = us_per(clock::now() - start, FRAMES);
+
+    start = clock::now();
+    for (int i = 0; i < FRAMES; i++)
+        sink += camera.view_projection()[3][2];
+    double still_us = us_per(clock::now() - start, FRAMES);
+
+    // the same orientations, as separate cameras and as a batch
+    std::vector<Camera> cameras(CAMERAS);
+    CameraBatch batch;
+    batch.resize(CAMERAS);
+    batch.fov_y = camera.zoom();
+    batch.aspect = (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT;
+
+    for (size_t i = 0; i < CAMERAS; i++) {
+        // float steps 5e-4 apart at 4 km, too coarse for the tolerance
+        batch.x[i] = i * 0.01;
+        batch.yaw[i] = i * 0.01f;
+        batch.pitch[i] = std::sin(i * 0.1f);
+        cameras[i].set_position({ batch.x[i], 0.0, 0.0 });
+        cameras[i].set_projection(batch.aspect, batch.near_plane, batch.far_plane);
+    }
+
+    std::vector<glm::mat4> matrices(CAMERAS);
+    // the batch's, where the matrices place the world
+    glm::dvec3 origin(0.0);
+
+    start = clock::now();
+    for (int f = 0; f < BATCH_FRAMES; f++) {
+        for (size_t i = 0; i < CAMERAS; i++) {
+            cameras[i].set_yaw(batch.yaw[i] + (f + 1) * 0.001f);
+            cameras[i].set_pitch(batch.pitch[i]);
+            matrices[i] = cameras[i].view_projection() * glm::translate(glm::mat4(1.0f), cameras[i].relative(origin));
+        }
+        sink += matrices[f][3][2];
+    }
+    double single_us = us_per(clock::now() - start, BATCH_FRAMES);
+
+    start = clock::now();
+    for (int f = 0; f < BATCH_FRAMES; f++) {
+        for (size_t i = 0; i < CAMERAS; i++)
+            batch.yaw[i] += 0.001f;
+        update_view_projections(batch, &matrices[0][0][0]);
+        sink += matrices[f][3][2];
+    }
+    double batch_us = us_per(clock::now() - start, BATCH_FRAMES);
+
+    // the batch must agree with the cameras it stands in for, at the yaw
+    // it summed up in float
+    float max_error = 0.0f;
+    for (size_t i = 0; i < CAMERAS; i++) {
+        cameras[i].set_yaw(batch.yaw[i]);
+        glm::mat4 expected = cameras[i].view_projection() * glm::translate(glm::mat4(1.0f), cameras[i].relative(origin));
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                max_error = std::max(max_error, std::abs(matrices[i][c][r] - expected[c][r]) / std::max(1.0f, std::abs(expected[c][r])));
+    }
+
+    std::cout << "camera: " << moving_us << " us per frame moving, " << still_us << " us cached, " << CAMERAS
+              << " cameras " << single_us << " us one by one, " << batch_us << " us batched, max relative error "
+              << max_error << "\n";
+
+    volatile float keep = sink;
+    (void)keep;
+
+    return max_error < 1e-3f ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// The renderer culls back faces with clockwise front faces, which has to
+// agree with the meshes and with meshlet cone culling. Checks the app's
+// triangle faces the starting camera, that no level of a simplified
+// terrain, clockwise seen from above, flips a triangle over, and that
+// the normal cones never cull a triangle that faces the eye, from eyes
+// above and below the terrain.
+static int run_winding_test()
+{
+    const int EYES = 200;
+
+    // clockwise front facing, like front_normal in meshlet.cpp
+    auto front_normal = [](const float* p0, const float* p1, const float* p2) {
+        glm::vec3 a(p0[0], p0[1], p0[2]), b(p1[0], p1[1], p1[2]), c(p2[0], p2[1], p2[2]);
+        return glm::cross(c - a, b - a);
+    };
+
+    Mesh scene = scene_mesh();
+    const float* corner = scene.vertices[0].position;
+    glm::vec3 to_camera = glm::vec3(Camera().position()) - glm::vec3(corner[0], corner[1], corner[2]);
+    bool scene_faces = glm::dot(front_normal(corner, scene.vertices[1].position, scene.vertices[2].position), to_camera) > 0.0f;
+
+    Mesh mesh = grid_mesh(64, 100.0f, 2.0f);
+    std::vector<MeshLod> lods = build_lod_chain(mesh, 6, 0.5f, 0.5f);
+    uint64_t flipped = 0, lod_triangles = 0;
+
+    for (const MeshLod& lod : lods) {
+        for (size_t t = 0; t < lod.indices.size(); t += 3) {
+            glm::vec3 n = front_normal(mesh.vertices[lod.indices[t]].position, mesh.vertices[lod.indices[t + 1]].position,
+                                       mesh.vertices[lod.indices[t + 2]].position);
+            flipped += n.y < 0.0f;
+            lod_triangles++;
+        }
+    }
+
+    PackedMesh packed = pack_mesh(mesh.vertices, lods);
+    MeshletMesh meshlets = build_meshlets(packed, 64, 124);
+
+    // no frustum, only the cones cull
+    CullView view = {};
+    for (int p = 0; p < 6; p++)
+        view.planes[p][3] = 1.0f;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> across(-80.0f, 80.0f), up(-20.0f, 20.0f);
+    uint64_t wrongly_culled = 0, culled = 0, triangles = 0;
+
+    for (int e = 0; e < EYES; e++) {
+        glm::vec3 eye(across(rng), up(rng), across(rng));
+        memcpy(view.camera_position, &eye[0], sizeof(view.camera_position));
+
+        std::vector<uint8_t> index_data;
+        std::vector<MeshChunk> chunks;
+        MeshletCullStats stats;
+        cull_meshlets(packed.chunks, meshlets, 0, (uint32_t)packed.chunks.size(), &view, 1, index_data, chunks, stats);
+        culled += stats.triangles_culled;
+        triangles += stats.triangles;
+
+        auto read = [&index_data](const MeshChunk& chunk, size_t i) {
+            if (chunk.index_width == IndexWidth::U16) {
+                uint16_t v;
+                memcpy(&v, &index_data[chunk.index_offset + i * 2], 2);
+                return (uint32_t)v + chunk.vertex_offset;
+            }
+
+            uint32_t v;
+            memcpy(&v, &index_data[chunk.index_offset + i * 4], 4);
+            return v + chunk.vertex_offset;
+        };
+
+        std::set<std::array<uint32_t, 3>> drawn;
+        for (const MeshChunk& chunk : chunks)
+            for (size_t i = 0; i < chunk.index_count; i += 3)
+                drawn.insert({ read(chunk, i), read(chunk, i + 1), read(chunk, i + 2) });
+
+        for (size_t c = 0; c < packed.chunks.size(); c++) {
+            uint32_t base = packed.chunks[c].vertex_offset;
+
+            for (uint32_t m = meshlets.chunk_meshlets[c]; m < meshlets.chunk_meshlets[c + 1]; m++) {
+                const Meshlet& meshlet = meshlets.meshlets[m];
+
+                for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+                    const uint32_t* local = &meshlets.indices[meshlet.index_offset + t * 3];
+                    std::array<uint32_t, 3> tri = { base + local[0], base + local[1], base + local[2] };
+                    const float* p0 = packed.vertices[tri[0]].position;
+
+                    glm::vec3 n = front_normal(p0, packed.vertices[tri[1]].position, packed.vertices[tri[2]].position);
+                    glm::vec3 to_eye = eye - glm::vec3(p0[0], p0[1], p0[2]);
+                    bool facing = glm::dot(n, to_eye) > 1e-4f * glm::length(n) * glm::length(to_eye);
+
+                    wrongly_culled += facing && drawn.count(tri) == 0;
+                }
+            }
+        }
+    }
+
+    uint64_t errors = !scene_faces + flipped + wrongly_culled;
+
+    std::cout << "winding: app triangle " << (scene_faces ? "faces" : "faces away from")
+              << " the camera, " << flipped << " of " << lod_triangles << " triangles flipped over " << lods.size()
+              << " levels, cones culled " << 100.0 * culled / triangles << "% over " << EYES << " eyes, "
+              << wrongly_culled << " facing the eye\n";
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// CPU side of multi view rendering on a ground plane seen from above:
+// culling once for all views and fetching each vertex once, against a
+// pass per view. Overlapping views are side by side like stereo eyes or
+// monitors, surrounding ones are turned around the camera like cube map
+// faces and share little.
+static int run_multiview_benchmark()
+{
+    const int GRID = 256;
+    const float GRID_SIZE = 100.0f;
+    const int ITERATIONS = 50;
+    // between neighbouring overlapping views
+    const float VIEW_OFFSET = 0.065f;
+    const float VIEW_TURN = 0.05f;
+
+    Mesh mesh = grid_mesh(GRID, GRID_SIZE, 0.0f);
+
+    PackedMesh packed = pack_mesh(mesh);
+    MeshletMesh meshlets = build_meshlets(packed, 64, 124);
+    QuantizedVertices vertices = quantize_vertices<RenderVertexLayout>(packed.vertices);
+    const PackedLod& lod = packed.lods[0];
+
+    Camera camera;
+    camera.set_position({ 0.0, 2.0, 0.0 });
+    camera.set_pitch(-0.5f);
+    camera.set_projection(1.0f, 0.1f, 1000.0f);
+
+    bool ok = true;
+
+    for (bool surrounding : { false, true }) {
+        for (size_t view_count : { 1, 2, 6 }) {
+            CullView views[MAX_VIEWS];
+            glm::mat4 mvps[MAX_VIEWS];
+
+            for (size_t i = 0; i < view_count; i++) {
+                Camera moved = camera;
+                if (surrounding) {
+                    moved.set_yaw(camera.yaw() + glm::two_pi<float>() * i / view_count);
+                }
+                else {
+                    moved.set_yaw(camera.yaw() + VIEW_TURN * i);
+                    moved.set_position(camera.position() + glm::dvec3(camera.right() * (VIEW_OFFSET * i)));
+                }
+
+                // the plane is at the world origin
+                glm::vec3 eye(moved.position());
+                mvps[i] = moved.view_projection() * glm::translate(glm::mat4(1.0f), -eye);
+                frustum_planes(&mvps[i][0][0], views[i].planes);
+                memcpy(views[i].camera_position, &eye[0], sizeof(float) * 3);
+            }
+
+            std::vector<uint8_t> index_data;
+            std::vector<MeshChunk> chunks;
+            MeshletCullStats stats;
+            cull_meshlets(packed.chunks, meshlets, lod.first_chunk, lod.chunk_count, views, view_count,
+                          index_data, chunks, stats);
+
+            MultiviewThroughput throughput = measure_multiview<RenderVertexLayout>(
+                    packed.chunks, meshlets, lod.first_chunk, lod.chunk_count, vertices, views, &mvps[0][0][0],
+                    view_count, ITERATIONS);
+
+            std::cout << "multi view, " << view_count << (surrounding ? " surrounding" : " overlapping")
+                      << (view_count == 1 ? " view: " : " views: ") << stats.triangles - stats.triangles_culled
+                      << " of " << stats.triangles << " triangles kept, " << throughput.shared
+                      << " views/s in one pass, " << throughput.separate << " views/s in separate passes ("
+                      << throughput.shared / throughput.separate << "x)\n";
+
+            ok = ok && stats.triangles_culled < stats.triangles;
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Draws a few millimetres of geometry two metres in front of the camera
+// with both far from the origin, and compares where the vertices land on
+// screen with a double precision reference: the float world space
+// matrices the renderer used to build against the camera relative ones.
+static int run_precision_test()
+{
+    const double DISTANCES[] = { 0.0, 1e3, 1e5, 5e5, 1e7 };
+    const float VERTEX_SPACING = 0.005f;
+    // of a pixel, anything visible is far above it
+    const double TOLERANCE = 0.01;
+
+    bool ok = true;
+
+    for (double distance : DISTANCES) {
+        Camera camera;
+        camera.set_projection((float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 1000.0f);
+        camera.set_position({ distance, 1.7, distance });
+        camera.set_yaw(camera.yaw() + 0.3f);
+        camera.set_pitch(-0.2f);
+
+        Model object;
+        object.translate = camera.position() + glm::dvec3(camera.front() * 2.0f);
+        object.rotate = glm::vec3(0.1f, 0.2f, 0.3f);
+        object.scale = glm::vec3(1.0f);
+
+        Model local = object;
+        local.translate = glm::dvec3(0.0);
+        glm::mat4 model = local.model_mat(glm::dvec3(0.0));
+        glm::mat4 relative = camera.view_projection() * object.model_mat(camera.position());
+
+        // what a world space view and model matrix come to in float
+        glm::mat4 absolute_view = camera.view();
+        absolute_view[3] = glm::vec4(-(glm::mat3(absolute_view) * glm::vec3(camera.position())), 1.0f);
+        glm::mat4 absolute = camera.projection() * absolute_view * glm::translate(glm::mat4(1.0f), glm::vec3(object.translate)) * model;
+
+        // the same in double, object to world to camera
+        glm::dmat4 reference_model = glm::translate(glm::dmat4(1.0), object.translate) * glm::dmat4(model);
+        glm::dmat4 reference = glm::dmat4(camera.view_projection()) * glm::translate(glm::dmat4(1.0), -camera.position()) * reference_model;
+
+        double absolute_error = 0.0, relative_error = 0.0;
+
+        for (int y = -2; y <= 2; y++) {
+            for (int x = -2; x <= 2; x++) {
+                glm::vec4 v(x * VERTEX_SPACING, y * VERTEX_SPACING, 0.0f, 1.0f);
+
+                glm::dvec4 expected = reference * glm::dvec4(v);
+                glm::dvec2 pixel = glm::dvec2(expected) / expected.w;
+
+                auto error = [&pixel](const glm::vec4& clip) {
+                    glm::dvec2 d = glm::dvec2(clip) / (double)clip.w - pixel;
+                    return glm::length(d * glm::dvec2(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2));
+                };
+
+                absolute_error = std::max(absolute_error, error(absolute * v));
+                relative_error = std::max(relative_error, error(relative * v));
+            }
+        }
+
+        std::cout << "precision at " << distance / 1000.0 << " km: world space matrices off by up to "
+                  << absolute_error << " px, camera relative " << relative_error << " px\n";
+
+        ok = ok && relative_error < TOLERANCE;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Cost of rebasing many objects onto a moving camera every frame, one by
+// one with glm and as a batch, around a camera hundreds of kilometres
+// out.
+static int run_rebase_benchmark()
+{
+    using clock = std::chrono::steady_clock;
+
+    const size_t OBJECTS = 16384;
+    const int FRAMES = 200;
+    const double CAMERA_DISTANCE = 3e5;
+    const double SPREAD = 1e4;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> offset(-SPREAD, SPREAD);
+    std::uniform_real_distribution<float> angle(-glm::pi<float>(), glm::pi<float>());
+    std::uniform_real_distribution<float> size(0.5f, 2.0f);
+
+    Camera camera;
+    camera.set_projection((float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 1e5f);
+    camera.set_position(glm::dvec3(CAMERA_DISTANCE));
+
+    ObjectBatch batch;
+    batch.resize(OBJECTS);
+    std::vector<glm::dvec3> positions(OBJECTS);
+    std::vector<glm::mat3> linears(OBJECTS);
+
+    for (size_t i = 0; i < OBJECTS; i++) {
+        positions[i] = camera.position() + glm::dvec3(offset(rng), offset(rng), offset(rng));
+        linears[i] = glm::mat3(glm::eulerAngleZYX(angle(rng), angle(rng), angle(rng))) * size(rng);
+
+        batch.x[i] = positions[i].x;
+        batch.y[i] = positions[i].y;
+        batch.z[i] = positions[i].z;
+        for (int k = 0; k < 9; k++)
+            batch.linear[k][i] = linears[i][k / 3][k % 3];
+    }
+
+    std::vector<glm::mat4> single(OBJECTS), batched(OBJECTS);
+    float sink = 0.0f;
+
+    auto start = clock::now();
+    for (int f = 0; f < FRAMES; f++) {
+        camera.set_position(camera.position() + glm::dvec3(0.01, 0.0, 0.0));
+
+        for (size_t i = 0; i < OBJECTS; i++) {
+            glm::mat4 model(linears[i]);
+            model[3] = glm::vec4(camera.relative(positions[i]), 1.0f);
+            single[i] = camera.view_projection() * model;
+        }
+        sink += single[f][3][2];
+    }
+    clock::duration single_time = clock::now() - start;
+
+    camera.set_position(glm::dvec3(CAMERA_DISTANCE));
+
+    start = clock::now();
+    for (int f = 0; f < FRAMES; f++) {
+        camera.set_position(camera.position() + glm::dvec3(0.01, 0.0, 0.0));
+        rebase_model_view_projections(batch, &camera.position()[0], &camera.view_projection()[0][0], &batched[0][0][0]);
+        sink += batched[f][3][2];
+    }
+    clock::duration batch_time = clock::now() - start;
+
+    float max_error = 0.0f;
+    for (size_t i = 0; i < OBJECTS; i++) {
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                max_error = std::max(max_error, std::abs(batched[i][c][r] - single[i][c][r]) / std::max(1.0f, std::abs(single[i][c][r])));
+    }
+
+    auto us = [](clock::duration d) { return std::chrono::duration<double, std::micro>(d).count() / FRAMES; };
+
+    std::cout << "rebase: " << OBJECTS << " objects " << us(single_time) << " us per frame one by one, "
+              << us(batch_time) << " us batched (" << us(batch_time) * 1000.0 / OBJECTS
+              << " ns per object), max relative error " << max_error << "\n";
+
+    volatile float keep = sink;
+    (void)keep;
+
+    return max_error < 1e-3f ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Random allocations of mixed sizes and alignments against a map of what
+// should be live, each filled with its own pattern. Ranges must stay
+// aligned, inside the heap and apart, the pattern must survive until the
+// free, and the stats must match the gaps between live ranges: freed
+// neighbours merge, so every gap is exactly one free block. Every so
+// often the heap is compacted, the moves applied to the backing memory,
+// and everything is checked again.
+static int run_tlsf_test()
+{
+    const uint64_t HEAP_SIZE = 4 << 20;
+    const int OPERATIONS = 200000;
+    const size_t MAX_LIVE = 2048;
+    const int STATS_INTERVAL = 1000;
+    const int COMPACT_INTERVAL = 20000;
+
+    struct Live {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t alignment;
+        uint8_t seed;
+    };
+
+    Tlsf tlsf(HEAP_SIZE);
+    std::vector<uint8_t> memory(HEAP_SIZE);
+    std::unordered_map<uint32_t, Live> live;
+    std::vector<uint32_t> blocks;
+
+    std::mt19937_64 rng(1);
+    uint64_t errors = 0, failed = 0, compactions = 0, moves = 0;
+
+    auto pattern_intact = [&](const Live& l) {
+        for (uint64_t i = 0; i < l.size; i++)
+            if (memory[l.offset + i] != (uint8_t)(l.seed + i))
+                return false;
+        return true;
+    };
+
+    // live ranges by offset, overlaps and misalignments count as errors
+    auto check = [&]() {
+        std::map<uint64_t, const Live*> ranges;
+        for (const auto& entry : live) {
+            const Live& l = entry.second;
+            errors += l.offset % l.alignment != 0 || l.offset + l.size > HEAP_SIZE || tlsf.offset(entry.first) != l.offset;
+            ranges[l.offset] = &l;
+        }
+
+        uint64_t cursor = 0, used = 0, largest_gap = 0;
+        uint32_t gaps = 0;
+        auto gap = [&](uint64_t end) {
+            if (end > cursor) {
+                gaps++;
+                largest_gap = std::max(largest_gap, end - cursor);
+            }
+        };
+
+        for (const auto& range : ranges) {
+            errors += range.first < cursor;
+            gap(range.first);
+            cursor = std::max(cursor, range.first + range.second->size);
+            used += range.second->size;
+        }
+        gap(HEAP_SIZE);
+
+        Tlsf::Stats s = tlsf.stats();
+        float fragmentation = s.size > used ? 1.0f - (float)largest_gap / (float)(s.size - used) : 0.0f;
+
+        errors += s.size != HEAP_SIZE || s.used != used || s.free != HEAP_SIZE - used || s.allocations != live.size()
+            || s.free_blocks != gaps || s.largest_free != largest_gap || std::abs(s.fragmentation - fragmentation) > 1e-6f;
+    };
+
+    for (int op = 1; op <= OPERATIONS; op++) {
+        if (rng() % MAX_LIVE >= blocks.size()) {
+            // mostly small buffers, a few large ones
+            uint64_t size = rng() % 8 == 0 ? 1 + rng() % (64 << 10) : 1 + rng() % 1024;
+            uint64_t alignment = 1ull << (rng() % 13);
+
+            Tlsf::Allocation a;
+            if (!tlsf.allocate(size, alignment, a)) {
+                failed++;
+                continue;
+            }
+
+            errors += live.count(a.block) != 0 || a.size < size || a.offset != tlsf.offset(a.block);
+
+            Live l = { a.offset, a.size, std::max(alignment, Tlsf::GRANULARITY), (uint8_t)rng() };
+            for (uint64_t i = 0; i < l.size; i++)
+                memory[l.offset + i] = (uint8_t)(l.seed + i);
+
+            live[a.block] = l;
+            blocks.push_back(a.block);
+        }
+        else if (!blocks.empty()) {
+            size_t i = rng() % blocks.size();
+            uint32_t block = blocks[i];
+
+            errors += !pattern_intact(live[block]);
+            tlsf.free(block);
+            live.erase(block);
+
+            blocks[i] = blocks.back();
+            blocks.pop_back();
+        }
+
+        if (op % STATS_INTERVAL == 0)
+            check();
+
+        if (op % COMPACT_INTERVAL == 0) {
+            uint64_t previous_end = 0;
+
+            for (const Tlsf::Move& m : tlsf.compact()) {
+                // moves only go down, and in order none lands on data
+                // still waiting to move
+                errors += m.to > m.from || m.to < previous_end || live[m.block].offset != m.from;
+                memmove(memory.data() + m.to, memory.data() + m.from, m.size);
+                live[m.block].offset = m.to;
+                previous_end = m.to + m.size;
+                moves++;
+            }
+
+            for (const auto& entry : live)
+                errors += !pattern_intact(entry.second);
+
+            check();
+            compactions++;
+        }
+    }
+
+    std::cout << "tlsf: " << OPERATIONS << " operations, mixed alignments up to 4096, " << live.size()
+              << " live at the end, " << failed << " out of space, " << compactions << " compactions moving "
+              << moves << " blocks, " << errors << " errors\n";
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Allocations and frees per second in steady state, a random live
+// allocation freed for each new one, next to malloc and free of the
+// same sizes.
+static int run_tlsf_benchmark()
+{
+    using clock = std::chrono::steady_clock;
+
+    const uint64_t HEAP_SIZE = 64 << 20;
+    const size_t LIVE = 4096;
+    const size_t PAIRS = 4000000;
+
+    std::mt19937 rng(1);
+    std::vector<uint32_t> sizes(LIVE + PAIRS), victims(PAIRS);
+    for (uint32_t& size : sizes)
+        size = 16 + rng() % 4096;
+    for (uint32_t& victim : victims)
+        victim = rng() % LIVE;
+
+    Tlsf tlsf(HEAP_SIZE);
+    std::vector<uint32_t> blocks(LIVE);
+    Tlsf::Allocation a;
+    bool ok = true;
+
+    for (size_t i = 0; i < LIVE; i++) {
+        ok = ok && tlsf.allocate(sizes[i], 256, a);
+        blocks[i] = a.block;
+    }
+
+    auto start = clock::now();
+    for (size_t i = 0; i < PAIRS; i++) {
+        tlsf.free(blocks[victims[i]]);
+        ok = ok && tlsf.allocate(sizes[LIVE + i], 256, a);
+        blocks[victims[i]] = a.block;
+    }
+    double tlsf_s = std::chrono::duration<double>(clock::now() - start).count();
+    Tlsf::Stats stats = tlsf.stats();
+
+    std::vector<void*> pointers(LIVE);
+    for (size_t i = 0; i < LIVE; i++)
+        pointers[i] = malloc(sizes[i]);
+
+    start = clock::now();
+    for (size_t i = 0; i < PAIRS; i++) {
+        free(pointers[victims[i]]);
+        pointers[victims[i]] = malloc(sizes[LIVE + i]);
+    }
+    double malloc_s = std::chrono::duration<double>(clock::now() - start).count();
+
+    uintptr_t sink = 0;
+    for (void* p : pointers) {
+        sink += (uintptr_t)p;
+        free(p);
+    }
+
+    std::cout << "tlsf: " << PAIRS / tlsf_s / 1e6 << " M alloc+free pairs/s with " << LIVE << " live, fragmentation "
+              << stats.fragmentation << ", malloc " << PAIRS / malloc_s / 1e6 << " M pairs/s";
+    if (ok)
+        std::cout << "\n";
+    else
+        std::cout << ", ran out of space\n";
+
+    volatile uintptr_t keep = sink;
+    (void)keep;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Drives the residency manager with plain memory under a budget a
+// quarter of the data: random resources are used each frame with two
+// frames in flight. Checks the budget holds once the GPU has caught up,
+// every reload brings back what was written and a reload that cannot get
+// memory reports failure instead of handing out nothing. Needs no GPU,
+// so it runs in the Linux build too.
+static int run_residency_test()
+{
+    const uint32_t RESOURCES = 64;
+    const uint64_t SIZE = 64 << 10;
+    const uint64_t BUDGET = RESOURCES * SIZE / 4;
+    const int FRAMES = 500;
+    const int USES_PER_FRAME = 4;
+    const uint64_t IN_FLIGHT = 2;
+
+    std::unordered_map<uint32_t, std::vector<uint8_t>> memory;
+    bool out_of_memory = false;
+
+    ResidencyManager::Callbacks callbacks;
+    callbacks.allocate = [&](ResourceHandle handle, uint64_t size) -> void* {
+        if (out_of_memory)
+            return nullptr;
+
+        std::vector<uint8_t>& m = memory[handle.id];
+        m.assign(size, 0);
+        return m.data();
+    };
+    callbacks.release = [&](ResourceHandle handle) { memory.erase(handle.id); };
+
+    ResidencyManager residency;
+    residency.init("residency_test", BUDGET, callbacks);
+
+    std::vector<ResourceHandle> handles;
+    for (uint32_t i = 0; i < RESOURCES; i++) {
+        ResourceHandle handle = residency.add(SIZE);
+        uint8_t* contents = (uint8_t*)residency.use(handle, 0);
+
+        for (uint64_t b = 0; b < SIZE; b++)
+            contents[b] = (uint8_t)(i * 31 + b);
+        handles.push_back(handle);
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<uint32_t> pick(0, RESOURCES - 1);
+    uint64_t over_budget = 0, corrupt = 0, evictions = 0, reloads = 0;
+
+    for (uint64_t frame = 1; frame <= FRAMES; frame++) {
+        for (int u = 0; u < USES_PER_FRAME; u++) {
+            uint32_t i = pick(rng);
+            const uint8_t* contents = (const uint8_t*)residency.use(handles[i], frame);
+
+            if (!contents || contents[0] != (uint8_t)(i * 31) || contents[SIZE - 1] != (uint8_t)(i * 31 + SIZE - 1))
+                corrupt++;
+        }
+
+        uint64_t completed = frame > IN_FLIGHT ? frame - IN_FLIGHT : 0;
+        residency.end_frame(completed);
+
+        const ResidencyManager::FrameStats& stats = residency.last_frame_stats();
+        evictions += stats.evictions;
+        reloads += stats.reloads;
+
+        // the frames in flight use less than the budget, so it always holds
+        if (stats.resident_bytes > BUDGET)
+            over_budget++;
+    }
+
+    // push everything out, then fail the next reload
+    residency.set_budget(0);
+    residency.end_frame(FRAMES);
+    out_of_memory = true;
+    bool reported = residency.use(handles[0], FRAMES + 1) == nullptr && !residency.resident(handles[0]);
+    out_of_memory = false;
+    bool recovered = residency.use(handles[0], FRAMES + 1) != nullptr;
+
+    residency.cleanup();
+
+    std::cout << "residency: " << RESOURCES << " x " << (SIZE >> 10) << " KB under a " << (BUDGET >> 10)
+              << " KB budget, " << evictions << " evictions, " << reloads << " reloads, " << over_budget
+              << " frames over budget, " << corrupt << " bad reloads, failed reload "
+              << (reported ? "reported" : "not reported") << "\n";
+
+    bool ok = over_budget == 0 && corrupt == 0 && evictions > 0 && reloads > 0 && reported && recovered;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// parallel_for speedup of a synthetic workload from one thread up to
+// all cores.
+static int run_job_benchmark()
+{
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<double> speedup = measure_job_scaling(threads, 1 << 16);
+
+    std::cout << "job system: " << threads << " threads, speedup";
+    for (size_t i = 0; i < speedup.size(); i++)
+        std::cout << " " << i + 1 << ":" << speedup[i];
+    std::cout << "\n";
+
+    return EXIT_SUCCESS;
+}
+
+// Jobs queued from workers, from jobs and from threads outside the
+// system all at once, over several init and cleanup cycles. Every job
+// must run exactly once. Meant to be run from a make TSAN=1 build, which
+// also reports any data race the handoffs let through.
+static int run_job_test()
+{
+    const int CYCLES = 8;
+    const size_t ITEMS = 1 << 16;
+    const int NESTED = 64;
+    const int OUTSIDE_THREADS = 4;
+    const int OUTSIDE_JOBS = 2000;
+
+    uint32_t threads = std::max(2u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> items(ITEMS);
+    uint64_t expected = 0, missing = 0;
+
+    for (int cycle = 0; cycle < CYCLES; cycle++) {
+        JobSystem jobs;
+        jobs.init(threads);
+
+        std::atomic<uint64_t> ran{0};
+
+        // threads the system did not start queue and wait on their own
+        std::vector<std::thread> outside;
+        for (int t = 0; t < OUTSIDE_THREADS; t++) {
+            outside.emplace_back([&jobs, &ran] {
+                JobCounter counter;
+                for (int j = 0; j < OUTSIDE_JOBS; j++)
+                    jobs.run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+                jobs.wait(counter);
+            });
+        }
+
+        // plain writes, each item by exactly one range
+        jobs.parallel_for(ITEMS, 256, [&items](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                items[i]++;
+        });
+
+        // jobs that queue more jobs from worker threads
+        JobCounter counter;
+        for (int n = 0; n < NESTED; n++) {
+            jobs.run([&jobs, &ran] {
+                JobCounter inner;
+                for (int k = 0; k < NESTED; k++)
+                    jobs.run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &inner);
+                jobs.wait(inner);
+                ran.fetch_add(1, std::memory_order_relaxed);
+            }, &counter);
+        }
+        jobs.wait(counter);
+
+        for (std::thread& t : outside)
+            t.join();
+
+        jobs.cleanup();
+
+        uint64_t want = (uint64_t)OUTSIDE_THREADS * OUTSIDE_JOBS + NESTED * (NESTED + 1);
+        expected += want;
+        missing += want - ran.load();
+    }
+
+    size_t wrong_items = 0;
+    for (uint32_t v : items)
+        wrong_items += v != (uint32_t)CYCLES;
+
+    std::cout << "jobs: " << expected << " jobs over " << CYCLES << " cycles on " << threads << " threads, "
+              << missing << " lost, " << wrong_items << " items not written once per cycle\n";
+
+    return missing == 0 && wrong_items == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// The std::map keyed key state InputManager used to keep, for the input
+// benchmark to compare against.
+class MapInputState
+{
+public:
+    struct KeyState {
+        bool pressed, held, released;
+    };
+
+    void update()
+    {
+        SDL_Event event;
+
+        mouse_x_rel = 0;
+        mouse_y_rel = 0;
+
+        while (SDL_PollEvent(&event) != 0) {
+            switch (event.type) {
+            case SDL_KEYDOWN:
+                new_keystate[event.key.keysym.sym] = true;
+                break;
+            case SDL_KEYUP:
+                new_keystate[event.key.keysym.sym] = false;
+                break;
+            case SDL_MOUSEMOTION:
+                mouse_x_rel += event.motion.xrel;
+                mouse_y_rel += event.motion.yrel;
+                break;
+            default:
+                break;
+            }
+        }
+
+        for (auto& [idx, k_state] : k_states) {
+            k_state.pressed = false;
+            k_state.released = false;
+
+            if (new_keystate[idx] != old_keystate[idx]) {
+                if (new_keystate[idx] == true) {
+                    k_state.pressed = !k_state.held;
+                    k_state.held = true;
+                }
+                else {
+                    k_state.released = true;
+                    k_state.held = false;
+                }
+            }
+
+            old_keystate[idx] = new_keystate[idx];
+        }
+    }
+
+    bool is_held(int k) { return k_states[k].held; }
+    bool is_pressed(int k) { return k_states[k].pressed; }
+    bool is_released(int k) { return k_states[k].released; }
+
+private:
+    int mouse_x_rel = 0, mouse_y_rel = 0;
+
+    std::map<SDL_Keycode, bool> new_keystate;
+    std::map<SDL_Keycode, bool> old_keystate;
+    std::map<SDL_Keycode, KeyState> k_states;
+};
+
+// Cost per frame of taking in a few key events and answering 100
+// held/pressed/released queries over 60 keys, with the map based state
+// and with InputManager's scancode bitsets. Both poll the same events
+// through SDL's queue, headless.
+static int run_input_benchmark()
+{
+    using clock = std::chrono::steady_clock;
+
+    const int FRAMES = 20000;
+    const int KEYS = 60;
+    const int QUERIES = 100;
+    const int EVENTS_PER_FRAME = 4;
+
+    if (SDL_Init(SDL_INIT_EVENTS) != 0) {
+        std::cerr << "Failed to init SDL events: " << SDL_GetError() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    // scancodes A onwards, the keycode is what the old state was keyed by
+    std::vector<SDL_Event> script;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> key(0, KEYS - 1);
+    std::bernoulli_distribution press(0.5);
+
+    for (int i = 0; i < FRAMES * EVENTS_PER_FRAME; i++) {
+        SDL_Event event = {};
+        event.type = press(rng) ? SDL_KEYDOWN : SDL_KEYUP;
+        event.key.keysym.scancode = (SDL_Scancode)(SDL_SCANCODE_A + key(rng));
+        event.key.keysym.sym = SDL_GetKeyFromScancode(event.key.keysym.scancode);
+        script.push_back(event);
+    }
+
+    std::vector<int> map_queries, flat_queries;
+    for (int q = 0; q < QUERIES; q++) {
+        SDL_Scancode scancode = (SDL_Scancode)(SDL_SCANCODE_A + q % KEYS);
+        map_queries.push_back(SDL_GetKeyFromScancode(scancode));
+        flat_queries.push_back(scancode);
+    }
+
+    // pushing the events is the same for both and left out of the time
+    auto run = [&](auto& state, const std::vector<int>& queries, uint32_t& sink) {
+        clock::duration total = clock::duration::zero();
+
+        for (int f = 0; f < FRAMES; f++) {
+            for (int e = 0; e < EVENTS_PER_FRAME; e++)
+                SDL_PushEvent(&script[f * EVENTS_PER_FRAME + e]);
+
+            auto start = clock::now();
+            state.update();
+            for (int k : queries)
+                sink += state.is_held(k) + state.is_pressed(k) * 2 + state.is_released(k) * 4;
+            total += clock::now() - start;
+        }
+
+        return std::chrono::duration<double, std::nano>(total).count() / FRAMES;
+    };
+
+    MapInputState map_state;
+    InputManager& input = InputManager::instance();
+    input.track_arrivals(false);
+
+    uint32_t map_sink = 0, flat_sink = 0;
+    double map_ns = run(map_state, map_queries, map_sink);
+    double flat_ns = run(input, flat_queries, flat_sink);
+
+    // nothing held for whatever runs next
+    for (int k = 0; k < KEYS; k++) {
+        SDL_Event event = {};
+        event.type = SDL_KEYUP;
+        event.key.keysym.scancode = (SDL_Scancode)(SDL_SCANCODE_A + k);
+        SDL_PushEvent(&event);
+    }
+    input.update();
+    SDL_Quit();
+
+    std::cout << "input: " << FRAMES << " frames of " << EVENTS_PER_FRAME << " events and " << QUERIES
+              << " queries, map " << map_ns << " ns per frame, bitsets " << flat_ns << " ns ("
+              << map_ns / flat_ns << "x)\n";
+
+    volatile uint32_t keep = map_sink + flat_sink;
+    (void)keep;
+
+    return EXIT_SUCCESS;
+}
+
+// Startup cost of getting a processed mesh, a grid x grid quad terrain,
+// with an empty asset cache (lod chain, packing, meshlets, then the
+// store) and with the entry the first run stored, copied out of the
+// mapping or read in place. The loaded mesh must match the processed
+// one byte for byte. --asset-grid 2048 makes an entry of about 500 MB.
+static int run_asset_cache_benchmark(int grid)
+{
+    using clock = std::chrono::steady_clock;
+
+    const int RUNS = 5;
+
+    char dir[] = "/tmp/asset_cacheXXXXXX";
+    if (!mkdtemp(dir)) {
+        std::cerr << "Failed to create a temporary directory\n";
+        return EXIT_FAILURE;
+    }
+
+    Mesh mesh = grid_mesh(grid, 100.0f, 2.0f);
+    uint64_t key = hash_bytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex), 0);
+    key = hash_bytes(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), key);
+
+    AssetCache cache(dir, 1ull << 40);
+
+    auto start = clock::now();
+    ProcessedMesh processed;
+    processed.packed = pack_mesh(mesh.vertices, build_lod_chain(mesh, 6, 0.5f, 0.5f));
+    processed.meshlets = build_meshlets(processed.packed, 64, 124);
+    std::vector<uint8_t> blob = write_mesh_blob(processed);
+    bool ok = cache.store(key, blob.data(), blob.size());
+    double cold_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+    double warm_ms = 0.0, in_place_ms = 0.0;
+
+    auto same = [](const auto& view, const auto& v) {
+        return view.size() == v.size() && (v.empty() || memcmp(view.begin(), v.data(), v.size() * sizeof(v[0])) == 0);
+    };
+    for (int r = 0; ok && r < RUNS; r++) {
+        start = clock::now();
+        MappedFile file;
+        ProcessedMesh loaded;
+        ok = cache.load(key, file)
+            && read_mesh_blob(file.data() + AssetCache::payload_offset(), file.size() - AssetCache::payload_offset(), loaded);
+        warm_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count() / RUNS;
+
+        ok = ok && write_mesh_blob(loaded) == blob;
+    }
+
+    for (int r = 0; ok && r < RUNS; r++) {
+        start = clock::now();
+        MappedFile file;
+        MeshBlobView view;
+        ok = cache.load(key, file)
+            && view_mesh_blob(file.data() + AssetCache::payload_offset(), file.size() - AssetCache::payload_offset(), view);
+        in_place_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count() / RUNS;
+
+        ok = ok && same(view.vertices, processed.packed.vertices) && same(view.index_data, processed.packed.index_data)
+            && same(view.chunks, processed.packed.chunks) && same(view.lods, processed.packed.lods)
+            && same(view.meshlets, processed.meshlets.meshlets) && same(view.meshlet_indices, processed.meshlets.indices)
+            && same(view.chunk_meshlets, processed.meshlets.chunk_meshlets);
+    }
+
+    std::filesystem::remove_all(dir);
+
+    std::cout << "asset cache: " << mesh.indices.size() / 3 << " triangles, " << blob.size() << " byte entry, "
+              << cold_ms << " ms cold, " << warm_ms << " ms warm, " << in_place_ms << " ms in place";
+    if (ok)
+        std::cout << " (" << cold_ms / warm_ms << "x, " << cold_ms / in_place_ms << "x)\n";
+    else
+        std::cout << ", cached mesh did not load back the same\n";
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+struct MockDevice;
+
+// stands in for MTL::Buffer in the resource pool test, released through
+// the renderer's ReleaseObject
+struct MockBuffer {
+    MockDevice* device;
+    uint64_t last_used;
+    bool released;
+
+    void release();
+};
+
+// stands in for MTL::Device, counts buffers made and released and
+// knows which frame the simulated GPU has completed
+struct MockDevice {
+    std::deque<MockBuffer> buffers;
+    uint64_t completed_frame = 0;
+    uint64_t released = 0;
+    uint64_t released_in_use = 0;
+    uint64_t released_twice = 0;
+
+    MockBuffer* newBuffer()
+    {
+        buffers.push_back({ this, 0, false });
+        return &buffers.back();
+    }
+};
+
+void MockBuffer::release()
+{
+    device->released_twice += released;
+    device->released_in_use += last_used > device->completed_frame;
+    device->released++;
+    released = true;
+}
+
+// Random creates and removes against a plain map of what should be
+// live, with lookups of live and removed handles in between. Live
+// handles must resolve to their own value, removed ones to nothing, and
+// iteration must see exactly the live values. Then the same churn goes
+// through a ResourceManager of mock buffers the way the renderer uses
+// it, with the GPU completing frames up to three behind. No buffer may
+// be released while a frame that used it is still in flight, and by
+// shutdown every buffer made must have been released exactly once.
+static int run_resource_pool_test()
+{
+    const int OPERATIONS = 1000000;
+    const size_t MAX_LIVE = 4096;
+    // removed handles to recheck, well under the 4095 generations a slot
+    // goes through before its handles repeat
+    const size_t STALE_KEPT = 1024;
+    const uint64_t FRAMES = 10000;
+    const int OPERATIONS_PER_FRAME = 50;
+    const uint64_t MAX_FRAMES_IN_FLIGHT = 3;
+
+    ResourcePool<uint64_t> pool;
+    std::unordered_map<uint32_t, uint64_t> live;
+    std::vector<ResourceHandle> handles, stale;
+
+    std::mt19937_64 rng(1);
+    uint64_t next_value = 1, errors = 0;
+
+    for (int op = 0; op < OPERATIONS; op++) {
+        // grows to about half of MAX_LIVE, then churns around it
+        bool create = rng() % MAX_LIVE >= handles.size();
+
+        if (create) {
+            ResourceHandle handle = pool.create(next_value);
+            errors += handle == NULL_HANDLE || live.count(handle.id) != 0;
+            live[handle.id] = next_value++;
+            handles.push_back(handle);
+        }
+        else {
+            size_t i = rng() % handles.size();
+            ResourceHandle handle = handles[i];
+            uint64_t value = 0;
+
+            errors += !pool.remove(handle, &value) || value != live[handle.id];
+            errors += pool.remove(handle, nullptr);
+            live.erase(handle.id);
+
+            handles[i] = handles.back();
+            handles.pop_back();
+
+            if (stale.size() < STALE_KEPT)
+                stale.push_back(handle);
+            else
+                stale[rng() % STALE_KEPT] = handle;
+        }
+
+        ResourceHandle probe = handles.empty() ? NULL_HANDLE : handles[rng() % handles.size()];
+        const uint64_t* value = pool.get(probe);
+        errors += !handles.empty() && (!value || *value != live[probe.id]);
+        errors += !stale.empty() && pool.get(stale[rng() % stale.size()]) != nullptr;
+    }
+
+    // dense storage holds exactly the live values
+    uint64_t sum = 0, expected_sum = 0;
+    for (uint64_t value : pool)
+        sum += value;
+    for (const auto& entry : live)
+        expected_sum += entry.second;
+    errors += pool.size() != live.size() || sum != expected_sum;
+
+    MockDevice device;
+    ResourceManager<MockBuffer*, ReleaseObject> manager;
+    handles.clear();
+
+    uint64_t frame = 1;
+    for (; frame <= FRAMES; frame++) {
+        for (int op = 0; op < OPERATIONS_PER_FRAME; op++) {
+            if (rng() % MAX_LIVE >= handles.size()) {
+                handles.push_back(manager.create(device.newBuffer()));
+            }
+            else {
+                // drawn with one last time this frame
+                size_t i = rng() % handles.size();
+                manager.get(handles[i])->last_used = frame;
+                manager.destroy(handles[i], frame);
+                errors += manager.get(handles[i]) != nullptr;
+                handles[i] = handles.back();
+                handles.pop_back();
+            }
+
+            // encoded into this frame
+            if (!handles.empty())
+                manager.get(handles[rng() % handles.size()])->last_used = frame;
+        }
+
+        // the GPU finishes anything from zero to two frames at a time and
+        // never falls more than three behind
+        uint64_t completed = std::min(frame - 1, device.completed_frame + rng() % 3);
+        device.completed_frame = std::max(completed, frame > MAX_FRAMES_IN_FLIGHT ? frame - MAX_FRAMES_IN_FLIGHT : 0);
+        manager.collect(device.completed_frame);
+    }
+
+    // shutdown waits for the GPU, then destroys what is left
+    device.completed_frame = frame - 1;
+    for (ResourceHandle handle : handles)
+        manager.destroy(handle, frame - 1);
+    manager.flush();
+
+    errors += manager.size() != 0 || manager.pending_count() != 0 || device.released != device.buffers.size();
+    errors += device.released_in_use + device.released_twice;
+
+    std::cout << "resource pool: " << OPERATIONS << " operations, " << live.size() << " live at the end, "
+              << device.buffers.size() << " mock buffers over " << FRAMES << " frames, " << device.released
+              << " released, " << errors << " errors\n";
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Size and decode rate of the compressed index stream on a 256 x 256
+// quad grid, in its row by row order and with the triangles shuffled,
+// where deltas between neighbours are large. Both must decode back to
+// the original indices.
+static int run_index_codec_benchmark()
+{
+    const int GRID = 256;
+    const int ITERATIONS = 100;
+
+    Mesh mesh = grid_mesh(GRID, 100.0f, 0.0f);
+
+    std::vector<uint32_t> shuffled = mesh.indices;
+    std::vector<uint32_t> order(shuffled.size() / 3);
+    for (size_t t = 0; t < order.size(); t++)
+        order[t] = (uint32_t)t;
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+    for (size_t t = 0; t < order.size(); t++)
+        memcpy(&shuffled[t * 3], &mesh.indices[order[t] * 3], sizeof(uint32_t) * 3);
+
+    bool ok = true;
+
+    for (const std::vector<uint32_t>* indices : { &mesh.indices, &shuffled }) {
+        std::vector<uint8_t> encoded = encode_indices(indices->data(), indices->size());
+        std::vector<uint32_t> decoded(decoded_index_count(encoded.data(), encoded.size()));
+        bool same = decoded.size() == indices->size()
+            && decode_indices(encoded.data(), encoded.size(), decoded.data()) && decoded == *indices;
+
+        IndexCodecStats stats = measure_index_codec(indices->data(), indices->size(), ITERATIONS);
+
+        std::cout << "index codec: " << (indices == &shuffled ? "shuffled " : "grid ") << indices->size()
+                  << " indices, " << stats.raw_bytes << " bytes as u32, " << stats.encoded_bytes << " compressed ("
+                  << (double)stats.encoded_bytes / indices->size() << " per index), "
+                  << stats.indices_per_second / 1e6 << " M indices/s decode" << (same ? "" : ", round trip failed")
+                  << "\n";
+
+        ok = ok && same;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#ifdef __APPLE__
+// in bench_metal.cpp
+int run_pipeline_benchmark();
+#endif
+
+// Runs the tests and benchmarks named on the command line, all of them
+// without any, and fails if any of them does.
+int main(int argc, char** argv)
+{
+    bool input_watch = false;
+    double fps = 60.0;
+    int asset_grid = 256;
+    std::vector<std::string> selected;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--input-watch") == 0)
+            input_watch = true;
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            fps = atof(argv[++i]);
+        else if (strcmp(argv[i], "--asset-grid") == 0 && i + 1 < argc)
+            asset_grid = atoi(argv[++i]);
+        else
+            selected.push_back(argv[i]);
+    }
+
+    struct Mode {
+        const char* flag;
+        std::function<int()> run;
+    };
+
+    const Mode modes[] = {
+        { "--timestep-test", run_timestep_test },
+        { "--input-latency-test", [input_watch] { return run_input_latency_test(input_watch); } },
+        { "--replay-test", run_replay_test },
+        { "--frame-pacing-test", [fps] { return run_frame_pacing_test(fps); } },
+        { "--resolution-test", run_resolution_test },
+        { "--camera-bench", run_camera_benchmark },
+        { "--multiview-bench", run_multiview_benchmark },
+        { "--winding-test", run_winding_test },
+        { "--precision-test", run_precision_test },
+        { "--rebase-bench", run_rebase_benchmark },
+#ifdef __APPLE__
+        { "--pipeline-bench", run_pipeline_benchmark },
+#endif
+        { "--tlsf-test", run_tlsf_test },
+        { "--tlsf-bench", run_tlsf_benchmark },
+        { "--residency-test", run_residency_test },
+        { "--job-bench", run_job_benchmark },
+        { "--job-test", run_job_test },
+        { "--input-bench", run_input_benchmark },
+        { "--asset-cache-bench", [asset_grid] { return run_asset_cache_benchmark(asset_grid); } },
+        { "--resource-pool-test", run_resource_pool_test },
+        { "--index-codec-bench", run_index_codec_benchmark },
+    };
+
+    for (const std::string& flag : selected) {
+        auto known = [&flag](const Mode& m) { return flag == m.flag; };
+
+        if (std::none_of(std::begin(modes), std::end(modes), known)) {
+            std::cerr << "Unknown option " << flag << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    int failed = 0;
+
+    for (const Mode& mode : modes) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), mode.flag) == selected.end())
+            continue;
+
+        if (mode.run() != EXIT_SUCCESS) {
+            std::cerr << mode.flag << " failed\n";
+            failed++;
+        }
+    }
+
+    return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pipeline_manager.h"
+
+// Benchmarks that need a Metal device, built into triangle_bench on
+// macOS only.
+
+// Time to get 200 pipeline variants ready with no binary archive and
+// with the archive the first run wrote. Also checks an archive missing
+// some of them gains the missing ones and stops missing after the next
+// start. The system's own shader cache may already hold the compiled
+// functions, so the cold time is a lower bound.
+int run_pipeline_benchmark()
+{
+    using clock = std::chrono::steady_clock;
+
+    const size_t PIPELINES = 200;
+    const VertexFormat FORMATS[] = {
+        VertexFormat::Float3, VertexFormat::Half4, VertexFormat::Short4Normalized, VertexFormat::UChar4Normalized,
+    };
+    const uint32_t FORMAT_SIZES[] = { 12, 8, 8, 4 };
+    const MTL::PixelFormat COLOR_FORMATS[] = {
+        MTL::PixelFormatBGRA8Unorm, MTL::PixelFormatBGRA8Unorm_sRGB, MTL::PixelFormatRGBA8Unorm,
+        MTL::PixelFormatRGBA8Unorm_sRGB, MTL::PixelFormatRGBA16Float, MTL::PixelFormatRGB10A2Unorm,
+        MTL::PixelFormatRG11B10Float, MTL::PixelFormatRGBA16Unorm, MTL::PixelFormatRGBA32Float,
+        MTL::PixelFormatBGR10A2Unorm,
+    };
+    const char* VERTEX_FUNCTIONS[] = { "VS", "VS_instanced" };
+
+    std::vector<PipelineDesc> descs;
+    for (const char* function : VERTEX_FUNCTIONS)
+        for (MTL::PixelFormat color_format : COLOR_FORMATS)
+            for (int p = 0; p < 4; p++)
+                for (int c = 0; c < 4; c++) {
+                    PipelineDesc desc;
+                    desc.vertex_function = function;
+                    desc.fragment_function = "FS";
+                    desc.color_format = color_format;
+                    desc.vertex_layout = { { FORMATS[p], 0 }, { FORMATS[c], FORMAT_SIZES[p] }, FORMAT_SIZES[p] + FORMAT_SIZES[c] };
+                    desc.max_amplification = 1;
+                    descs.push_back(desc);
+                }
+    descs.resize(PIPELINES);
+
+    NS::AutoreleasePool* pool = NS::AutoreleasePool::alloc()->init();
+    MTL::Device* device = MTL::CreateSystemDefaultDevice();
+    NS::Error* error = nullptr;
+    MTL::Library* library = device ? device->newLibrary(NS::String::string("shader.metallib", NS::ASCIIStringEncoding), &error) : nullptr;
+
+    if (!library) {
+        std::cerr << "Failed to load shader.metallib\n";
+        if (device)
+            device->release();
+        pool->release();
+        return EXIT_FAILURE;
+    }
+
+    char dir[] = "/tmp/pipelinesXXXXXX";
+    if (!mkdtemp(dir)) {
+        std::cerr << "Failed to create a temporary directory\n";
+        library->release();
+        device->release();
+        pool->release();
+        return EXIT_FAILURE;
+    }
+    std::string path = std::string(dir) + "/pipelines.binarchive";
+
+    // one start of the app: the first count variants until all are ready,
+    // then the archive is written if anything missed
+    auto start_up = [&](size_t count, double& ms) {
+        PipelineManager pipelines;
+        pipelines.init(device, library, path);
+
+        auto start = clock::now();
+        for (size_t i = 0; i < count; i++)
+            pipelines.request(descs[i]);
+        pipelines.wait_all();
+        ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+        uint32_t misses = pipelines.archive_misses();
+        pipelines.cleanup();
+
+        return misses;
+    };
+
+    double cold_ms, warm_ms, ms;
+    uint32_t cold_misses = start_up(PIPELINES, cold_ms);
+    uint32_t warm_misses = start_up(PIPELINES, warm_ms);
+
+    std::filesystem::remove(path);
+    start_up(PIPELINES / 2, ms);
+    uint32_t grown_misses = start_up(PIPELINES, ms);
+    uint32_t regrown_misses = start_up(PIPELINES, ms);
+
+    std::filesystem::remove_all(dir);
+    library->release();
+    device->release();
+    pool->release();
+
+    std::cout << "pipelines: " << PIPELINES << " variants " << cold_ms << " ms cold (" << cold_misses
+              << " compiled), " << warm_ms << " ms from the archive (" << warm_misses << " compiled), "
+              << "archive of half gained " << grown_misses << " then missed " << regrown_misses << "\n";
+
+    bool ok = cold_misses == PIPELINES && warm_misses == 0 && grown_misses == PIPELINES / 2 && regrown_misses == 0;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
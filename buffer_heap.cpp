@@ -0,0 +1,88 @@
+#include "buffer_heap.h"
+
+#include <algorithm>
+#include <cstring>
+
+void BufferHeap::init(MTL::Device* d, uint64_t size)
+{
+    device = d;
+    heap_size = size;
+}
+
+void BufferHeap::cleanup()
+{
+    for (Heap& heap : heaps)
+        heap.buffer->release();
+
+    heaps.clear();
+}
+
+bool BufferHeap::allocate(uint64_t size, uint64_t alignment, BufferAllocation& out)
+{
+    Tlsf::Allocation a;
+
+    for (uint32_t i = 0; i < heaps.size(); i++) {
+        if (heaps[i].allocator.allocate(size, alignment, a)) {
+            out = { heaps[i].buffer, a.offset, i, a.block };
+            return true;
+        }
+    }
+
+    uint64_t new_size = std::max(heap_size, Tlsf::capacity_for(size, alignment));
+    MTL::Buffer* buffer = device->newBuffer(new_size, MTL::CPUCacheModeDefaultCache);
+
+    if (!buffer)
+        return false;
+
+    buffer->setLabel(NS::String::string("Buffer heap", NS::ASCIIStringEncoding));
+    heaps.push_back({ buffer, Tlsf(new_size) });
+
+    uint32_t index = (uint32_t)heaps.size() - 1;
+
+    if (!heaps[index].allocator.allocate(size, alignment, a)) {
+        heaps.pop_back();
+        buffer->release();
+        return false;
+    }
+
+    out = { buffer, a.offset, index, a.block };
+
+    return true;
+}
+
+void BufferHeap::free(const BufferAllocation& allocation)
+{
+    heaps[allocation.heap].allocator.free(allocation.block);
+}
+
+Tlsf::Stats BufferHeap::stats() const
+{
+    Tlsf::Stats total = {};
+
+    for (const Heap& heap : heaps) {
+        Tlsf::Stats s = heap.allocator.stats();
+
+        total.size += s.size;
+        total.used += s.used;
+        total.free += s.free;
+        total.largest_free = std::max(total.largest_free, s.largest_free);
+        total.allocations += s.allocations;
+        total.free_blocks += s.free_blocks;
+    }
+
+    total.fragmentation = total.free > 0 ? 1.0f - (float)total.largest_free / (float)total.free : 0.0f;
+
+    return total;
+}
+
+void BufferHeap::compact(const std::function<void(const BufferAllocation&)>& moved)
+{
+    for (uint32_t i = 0; i < heaps.size(); i++) {
+        uint8_t* contents = (uint8_t*)heaps[i].buffer->contents();
+
+        for (const Tlsf::Move& m : heaps[i].allocator.compact()) {
+            memmove(contents + m.to, contents + m.from, m.size);
+            moved({ heaps[i].buffer, m.to, i, m.block });
+        }
+    }
+}
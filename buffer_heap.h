@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <Metal/Metal.hpp>
+
+#include "tlsf.h"
+
+struct BufferAllocation {
+    MTL::Buffer* buffer;
+    uint64_t offset;
+    uint32_t heap;
+    uint32_t block;
+};
+
+// Sub-allocates buffers out of a few large MTL::Buffers, each managed by
+// a Tlsf. A new heap is added when none has room, allocations larger than
+// heap_size get a heap of their own.
+class BufferHeap
+{
+public:
+    void init(MTL::Device* device, uint64_t heap_size);
+    void cleanup();
+
+    bool allocate(uint64_t size, uint64_t alignment, BufferAllocation& out);
+    void free(const BufferAllocation& allocation);
+
+    Tlsf::Stats stats() const;
+
+    // slides the allocations in every heap down and copies their data.
+    // the GPU must be done with the heaps, and anything holding an
+    // allocation or a pointer into one updates it from moved
+    void compact(const std::function<void(const BufferAllocation&)>& moved);
+
+private:
+    struct Heap {
+        MTL::Buffer* buffer;
+        Tlsf allocator;
+    };
+
+    MTL::Device* device;
+    uint64_t heap_size;
+    std::vector<Heap> heaps;
+};
@@ -7,37 +7,74 @@ const float PITCH = 0.0f;
 const float SPEED = 5.0f;
 const float SENSITIVITY = 0.002f;
 const float ZOOM = glm::quarter_pi<float>();
+const float ASPECT = 4.0f / 3.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 1000.0f;
 
 Camera::Camera()
-    : position({ 0.0f, 0.0f, 10.0f })
-    , yaw(YAW)
-    , pitch(PITCH)
-    , world_up({ 0.0f, 1.0f, 0.0f })
+    : m_position({ 0.0f, 0.0f, 10.0f })
+    , m_yaw(YAW)
+    , m_pitch(PITCH)
     , speed(SPEED)
     , sensitivity(SENSITIVITY)
     , m_zoom(ZOOM)
+    , m_aspect(ASPECT)
+    , m_near(NEAR_PLANE)
+    , m_far(FAR_PLANE)
     , m_constrain_pitch(true)
+    , projection_valid(false)
 {
-    update();
+    update_orientation();
 }
 
-void Camera::update()
+// yaw turns around world up and pitch around the camera's right axis, a
+// yaw of -90 degrees looks down -z like the identity does
+void Camera::update_orientation()
 {
-    glm::vec3 f;
+    glm::quat yaw_rotation = glm::angleAxis(-(m_yaw + glm::half_pi<float>()), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::quat pitch_rotation = glm::angleAxis(m_pitch, glm::vec3(1.0f, 0.0f, 0.0f));
 
-    f.x = glm::cos(yaw) * glm::cos(pitch);
-    f.y = glm::sin(pitch);
-    f.z = glm::sin(yaw) * glm::cos(pitch);
+    m_orientation = yaw_rotation * pitch_rotation;
+    moved();
+}
+
+void Camera::moved()
+{
+    view_valid = false;
+    view_projection_valid = false;
+    m_dirty = true;
+}
+
+const glm::mat4& Camera::view() const
+{
+    if (!view_valid) {
+        // inverse of the camera's rotation, the translation is left to
+        // relative()
+        m_view = glm::mat4(glm::mat3_cast(glm::conjugate(m_orientation)));
+        view_valid = true;
+    }
+
+    return m_view;
+}
 
-    front = glm::normalize(f);
+const glm::mat4& Camera::projection() const
+{
+    if (!projection_valid) {
+        m_projection = glm::perspectiveRH_ZO(m_zoom, m_aspect, m_near, m_far);
+        projection_valid = true;
+    }
 
-    right = glm::normalize(glm::cross(front, world_up));
-    up = glm::normalize(glm::cross(right, front));
+    return m_projection;
 }
 
-glm::mat4 Camera::look_at()
+const glm::mat4& Camera::view_projection() const
 {
-    return glm::lookAt(position, position + front, up);
+    if (!view_projection_valid) {
+        m_view_projection = projection() * view();
+        view_projection_valid = true;
+    }
+
+    return m_view_projection;
 }
 
 void Camera::process_keyboard(CameraDirection direction, float delta_time)
@@ -46,46 +83,47 @@ void Camera::process_keyboard(CameraDirection direction, float delta_time)
 
     switch (direction) {
     case CameraDirection::FORWARD:
-        position += front * velocity;
+        m_position += glm::dvec3(front() * velocity);
+        moved();
         break;
     case CameraDirection::BACKWARD:
-        position -= front * velocity;
+        m_position -= glm::dvec3(front() * velocity);
+        moved();
         break;
     case CameraDirection::LEFTWARD:
-        position -= right * velocity;
+        m_position -= glm::dvec3(right() * velocity);
+        moved();
         break;
     case CameraDirection::RIGHTWARD:
-        position += right * velocity;
+        m_position += glm::dvec3(right() * velocity);
+        moved();
         break;
 
     case CameraDirection::UP:
-        pitch += sensitivity * 3;
+        set_pitch(m_pitch + sensitivity * 3);
         break;
     case CameraDirection::DOWN:
-        pitch -= sensitivity * 3;
+        set_pitch(m_pitch - sensitivity * 3);
         break;
     case CameraDirection::LEFT:
-        yaw -= sensitivity * 6;
+        set_yaw(m_yaw - sensitivity * 6);
         break;
     case CameraDirection::RIGHT:
-        yaw += sensitivity * 6;
+        set_yaw(m_yaw + sensitivity * 6);
         break;
     }
-
-    constrain_pitch();
-    update();
 }
 
 void Camera::process_mouse(float x, float y)
 {
     int invert_mouse = -1;
 
-    yaw = glm::mod(yaw + x * sensitivity, glm::pi<float>() * 2);
+    m_yaw = glm::mod(m_yaw + x * sensitivity, glm::pi<float>() * 2);
 
-    pitch += (y * sensitivity) * invert_mouse;
+    m_pitch += (y * sensitivity) * invert_mouse;
 
     constrain_pitch();
-    update();
+    update_orientation();
 }
 
 void Camera::constrain_pitch()
@@ -94,23 +132,61 @@ void Camera::constrain_pitch()
         return;
 
     constexpr float pitch_limit = glm::half_pi<float>() - 0.01f;
-    pitch = glm::clamp(pitch, -pitch_limit, pitch_limit);
+    m_pitch = glm::clamp(m_pitch, -pitch_limit, pitch_limit);
 }
 
-float Camera::zoom()
+float Camera::zoom() const
 {
     return m_zoom;
 }
 
+void Camera::set_position(const glm::dvec3& p)
+{
+    m_position = p;
+    moved();
+}
+
 void Camera::set_pitch(float p)
 {
-    pitch = p;
+    m_pitch = p;
     constrain_pitch();
-    update();
+    update_orientation();
 }
 
 void Camera::set_yaw(float y)
 {
-    yaw = y;
-    update();
+    m_yaw = y;
+    update_orientation();
+}
+
+void Camera::set_projection(float aspect, float near_plane, float far_plane)
+{
+    m_aspect = aspect;
+    m_near = near_plane;
+    m_far = far_plane;
+
+    projection_valid = false;
+    view_projection_valid = false;
+    m_dirty = true;
+}
+
+Camera Camera::interpolate(const Camera& to, float t) const
+{
+    Camera c = *this;
+
+    // yaw wraps around, take the short way
+    float yaw_delta = glm::mod(to.m_yaw - m_yaw + glm::pi<float>(), glm::pi<float>() * 2) - glm::pi<float>();
+
+    c.m_position = glm::mix(m_position, to.m_position, (double)t);
+    c.m_yaw = m_yaw + yaw_delta * t;
+    c.m_pitch = glm::mix(m_pitch, to.m_pitch, t);
+
+    if (c.m_zoom != to.m_zoom) {
+        c.m_zoom = glm::mix(m_zoom, to.m_zoom, t);
+        c.projection_valid = false;
+    }
+
+    c.update_orientation();
+
+    return c;
 }
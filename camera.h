@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 enum class CameraDirection {
     FORWARD,
@@ -15,27 +16,62 @@ enum class CameraDirection {
     RIGHT,
 };
 
+// Orientation is a quaternion built from yaw and pitch when they change,
+// moving only touches the position. The matrices are computed when first
+// asked for after a change and cached until the next one.
+//
+// The position is in double precision world space and the view is camera
+// relative: it only rotates, so whatever is drawn with it is placed at
+// relative(world position), where float keeps its precision near the
+// camera however far from the origin it is.
 class Camera
 {
 public:
     Camera();
-    glm::mat4 look_at();
     void process_keyboard(CameraDirection, float);
     void process_mouse(float, float);
-    float zoom();
-    glm::vec3 position;
-    float yaw, pitch;
+    float zoom() const;
 
+    const glm::dvec3& position() const { return m_position; }
+    float yaw() const { return m_yaw; }
+    float pitch() const { return m_pitch; }
 
+    void set_position(const glm::dvec3&);
     void set_pitch(float);
     void set_yaw(float);
+    void set_projection(float aspect, float near_plane, float far_plane);
+
+    glm::vec3 front() const { return m_orientation * glm::vec3(0.0f, 0.0f, -1.0f); }
+    glm::vec3 right() const { return m_orientation * glm::vec3(1.0f, 0.0f, 0.0f); }
+    glm::vec3 up() const { return m_orientation * glm::vec3(0.0f, 1.0f, 0.0f); }
+
+    // offset from the camera, in float once the large parts cancel out
+    glm::vec3 relative(const glm::dvec3& p) const { return glm::vec3(p - m_position); }
+
+    const glm::mat4& view() const;
+    const glm::mat4& projection() const;
+    const glm::mat4& view_projection() const;
+
+    // state between this camera (t = 0) and to (t = 1)
+    Camera interpolate(const Camera& to, float t) const;
+
+    // set whenever the view may have changed, the owner clears it
+    bool dirty() const { return m_dirty; }
+    void clear_dirty() { m_dirty = false; }
 private:
-    glm::vec3 front, up, right;
-    glm::vec3 world_up;
+    glm::dvec3 m_position;
+    float m_yaw, m_pitch;
+    glm::quat m_orientation;
 
     float speed, sensitivity, m_zoom;
+    float m_aspect, m_near, m_far;
     bool m_constrain_pitch;
+    bool m_dirty;
+
+    mutable glm::mat4 m_view, m_projection, m_view_projection;
+    mutable bool view_valid, projection_valid, view_projection_valid;
 
-    void update();
+    void update_orientation();
+    void moved();
     void constrain_pitch();
 };
@@ -0,0 +1,180 @@
+#include "camera_batch.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// GCC/clang vector extensions, SSE or NEON registers depending on target
+typedef float f4 __attribute__((vector_size(16)));
+typedef int32_t i4 __attribute__((vector_size(16)));
+typedef double d4 __attribute__((vector_size(32)));
+
+static f4 splat(float v)
+{
+    return f4{ v, v, v, v };
+}
+
+static i4 splat(int32_t v)
+{
+    return i4{ v, v, v, v };
+}
+
+// mask lanes are all ones or all zeros
+static f4 select(i4 mask, f4 a, f4 b)
+{
+    return (f4)((mask & (i4)a) | (~mask & (i4)b));
+}
+
+static f4 load(const std::vector<float>& v, size_t first, size_t lanes)
+{
+    f4 r = {};
+    memcpy(&r, v.data() + first, lanes * sizeof(float));
+
+    return r;
+}
+
+// world positions are subtracted in double, only the offsets are float
+static f4 load_relative(const std::vector<double>& v, double origin, size_t first, size_t lanes)
+{
+    d4 r = {};
+    memcpy(&r, v.data() + first, lanes * sizeof(double));
+
+    return __builtin_convertvector(r - origin, f4);
+}
+
+static void store(const f4* m, size_t first, size_t lanes, float* out)
+{
+    for (size_t l = 0; l < lanes; l++) {
+        for (int k = 0; k < 16; k++)
+            out[(first + l) * 16 + k] = m[k][l];
+    }
+}
+
+// Cephes style, reduced to [-pi/4, pi/4] around the nearest multiple of
+// pi/2 with both polynomials evaluated and picked per quadrant. Errors
+// are a few ulp for angles a camera sees.
+static void sincos4(f4 x, f4& s, f4& c)
+{
+    f4 t = x * splat(0.636619772f) + splat(0.5f);
+    i4 q = __builtin_convertvector(t, i4);
+    // conversion truncates, rounds negatives up
+    q += (i4)(__builtin_convertvector(q, f4) > t);
+
+    f4 qf = __builtin_convertvector(q, f4);
+    f4 r = x - qf * splat(1.5703125f) - qf * splat(4.837512969970703125e-4f) - qf * splat(7.549789954891882e-8f);
+    f4 r2 = r * r;
+
+    f4 ps = r + r * r2 * (splat(-1.6666654611e-1f) + r2 * (splat(8.3321608736e-3f) + r2 * splat(-1.9515295891e-4f)));
+    f4 pc = splat(1.0f) - splat(0.5f) * r2
+        + r2 * r2 * (splat(4.166664568298827e-2f) + r2 * (splat(-1.388731625493765e-3f) + r2 * splat(2.443315711809948e-5f)));
+
+    i4 zero = splat(0);
+    i4 sign = splat(INT32_MIN);
+    i4 swap = (q & splat(1)) != zero;
+
+    s = select(swap, pc, ps);
+    c = select(swap, ps, pc);
+    s = (f4)((i4)s ^ (((q & splat(2)) != zero) & sign));
+    c = (f4)((i4)c ^ ((((q + splat(1)) & splat(2)) != zero) & sign));
+}
+
+void CameraBatch::resize(size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    yaw.resize(count);
+    pitch.resize(count);
+}
+
+void update_view_projections(const CameraBatch& batch, float* out)
+{
+    // the projection is mostly zeros, only these entries are multiplied in
+    float tan_half = std::tan(batch.fov_y * 0.5f);
+    f4 p00 = splat(1.0f / (batch.aspect * tan_half));
+    f4 p11 = splat(1.0f / tan_half);
+    f4 p22 = splat(batch.far_plane / (batch.near_plane - batch.far_plane));
+    f4 p32 = splat(-(batch.far_plane * batch.near_plane) / (batch.far_plane - batch.near_plane));
+
+    size_t count = batch.size();
+
+    for (size_t i = 0; i < count; i += 4) {
+        size_t lanes = std::min<size_t>(4, count - i);
+
+        f4 x = load_relative(batch.x, batch.origin[0], i, lanes);
+        f4 y = load_relative(batch.y, batch.origin[1], i, lanes);
+        f4 z = load_relative(batch.z, batch.origin[2], i, lanes);
+
+        f4 sy, cy, sp, cp;
+        sincos4(load(batch.yaw, i, lanes), sy, cy);
+        sincos4(load(batch.pitch, i, lanes), sp, cp);
+
+        // front, right and up in closed form, right has no y
+        f4 fx = cy * cp, fy = sp, fz = sy * cp;
+        f4 rx = -sy, rz = cy;
+        f4 ux = -cy * sp, uy = cp, uz = -sy * sp;
+
+        f4 tx = -(rx * x + rz * z);
+        f4 ty = -(ux * x + uy * y + uz * z);
+        f4 tz = fx * x + fy * y + fz * z;
+
+        // projection times the look at matrix, by column
+        f4 m[16] = {
+            p00 * rx, p11 * ux, -p22 * fx, fx,
+            splat(0.0f), p11 * uy, -p22 * fy, fy,
+            p00 * rz, p11 * uz, -p22 * fz, fz,
+            p00 * tx, p11 * ty, p22 * tz + p32, -tz,
+        };
+
+        store(m, i, lanes, out);
+    }
+}
+
+void ObjectBatch::resize(size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+
+    for (std::vector<float>& v : linear)
+        v.resize(count);
+}
+
+void rebase_model_view_projections(const ObjectBatch& objects, const double camera_position[3],
+                                   const float* view_projection, float* out)
+{
+    f4 vp[16];
+    for (int k = 0; k < 16; k++)
+        vp[k] = splat(view_projection[k]);
+
+    size_t count = objects.size();
+
+    for (size_t i = 0; i < count; i += 4) {
+        size_t lanes = std::min<size_t>(4, count - i);
+
+        // the model matrix's columns, the last one being the offset from
+        // the camera
+        f4 model[4][3];
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++)
+                model[c][r] = load(objects.linear[c * 3 + r], i, lanes);
+        }
+
+        model[3][0] = load_relative(objects.x, camera_position[0], i, lanes);
+        model[3][1] = load_relative(objects.y, camera_position[1], i, lanes);
+        model[3][2] = load_relative(objects.z, camera_position[2], i, lanes);
+
+        f4 m[16];
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                m[c * 4 + r] = vp[r] * model[c][0] + vp[4 + r] * model[c][1] + vp[8 + r] * model[c][2];
+                if (c == 3)
+                    m[c * 4 + r] += vp[12 + r];
+            }
+        }
+
+        store(m, i, lanes, out);
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Many cameras in structure of arrays form, for multi view or shadow
+// cascades, sharing one projection. Angles are in radians like Camera's,
+// positions are in double precision world space like Camera's.
+struct CameraBatch {
+    std::vector<double> x, y, z;
+    std::vector<float> yaw, pitch;
+    // the matrices are relative to it, usually the main camera's position
+    double origin[3] = { 0.0, 0.0, 0.0 };
+
+    float fov_y = 0.785398f;
+    float aspect = 1.0f;
+    float near_plane = 0.1f;
+    float far_plane = 1000.0f;
+
+    void resize(size_t count);
+    size_t size() const { return x.size(); }
+};
+
+// Writes each camera's view projection matrix to out, 16 floats column
+// major like glm::mat4, the same as Camera::view_projection() times a
+// translation to camera.relative(origin) up to float rounding. Works on
+// four cameras at a time in SIMD registers.
+void update_view_projections(const CameraBatch& batch, float* out);
+
+// Objects in double precision world space, each with a float rotation
+// and scale kept as the nine entries of a column major 3x3 matrix.
+struct ObjectBatch {
+    std::vector<double> x, y, z;
+    std::vector<float> linear[9];
+
+    void resize(size_t count);
+    size_t size() const { return x.size(); }
+};
+
+// Camera relative model view projection of every object: the difference
+// to camera_position is taken in double and only the result goes to
+// float. view_projection is the camera's, Camera::view_projection(), and
+// out gets 16 floats per object like update_view_projections.
+void rebase_model_view_projections(const ObjectBatch& objects, const double camera_position[3],
+                                   const float* view_projection, float* out);
@@ -0,0 +1,45 @@
+#include "embedded.h"
+
+#include <cstring>
+
+#ifdef EMBED_ASSETS
+
+extern "C" {
+extern const uint8_t embedded_shader_metallib[];
+extern const uint8_t embedded_shader_metallib_end[];
+extern const uint8_t embedded_mesh_blob[];
+extern const uint8_t embedded_mesh_blob_end[];
+}
+
+struct EmbeddedEntry {
+    const char* name;
+    const uint8_t* begin;
+    const uint8_t* end;
+};
+
+static const EmbeddedEntry entries[] = {
+    { "shader.metallib", embedded_shader_metallib, embedded_shader_metallib_end },
+    { "mesh.blob", embedded_mesh_blob, embedded_mesh_blob_end },
+};
+
+bool embedded_file(const char* name, EmbeddedFile& out)
+{
+    for (const EmbeddedEntry& e : entries) {
+        if (strcmp(e.name, name) == 0) {
+            out.data = e.begin;
+            out.size = (size_t)(e.end - e.begin);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#else
+
+bool embedded_file(const char*, EmbeddedFile&)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct EmbeddedFile {
+    const uint8_t* data;
+    size_t size;
+};
+
+// files linked in by embed.S, only available in builds made with
+// EMBED=1. returns false otherwise so callers fall back to the file
+bool embedded_file(const char* name, EmbeddedFile& out);
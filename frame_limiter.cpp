@@ -0,0 +1,93 @@
+#include "frame_limiter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+
+// sleeps can wake this late, the rest of the wait spins
+#ifdef __linux__
+const auto SPIN_MARGIN = std::chrono::microseconds(250);
+#else
+const auto SPIN_MARGIN = std::chrono::microseconds(1000);
+#endif
+
+void FrameLimiter::init(double target_hz)
+{
+    period = target_hz > 0.0
+        ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / target_hz))
+        : clock::duration(0);
+
+    started = false;
+    frames = 0;
+    missed = 0;
+    mean = 0.0;
+    m2 = 0.0;
+    max_late = 0.0;
+}
+
+void FrameLimiter::wait()
+{
+    clock::time_point now = clock::now();
+
+    if (!started) {
+        started = true;
+        deadline = now;
+        last_frame = now;
+        return;
+    }
+
+    if (enabled()) {
+        deadline += period;
+
+        if (now > deadline) {
+            missed++;
+            deadline = now;
+        }
+        else {
+            if (deadline - now > SPIN_MARGIN)
+                sleep_until(deadline - SPIN_MARGIN);
+
+            while ((now = clock::now()) < deadline) {
+            }
+
+            max_late = std::max(max_late, std::chrono::duration<double, std::milli>(now - deadline).count());
+        }
+    }
+
+    double frame_ms = std::chrono::duration<double, std::milli>(now - last_frame).count();
+    last_frame = now;
+
+    frames++;
+    double d = frame_ms - mean;
+    mean += d / frames;
+    m2 += d * (frame_ms - mean);
+}
+
+FrameLimiter::Stats FrameLimiter::stats() const
+{
+    return { frames, missed, mean, frames > 1 ? m2 / (frames - 1) : 0.0, max_late };
+}
+
+void FrameLimiter::sleep_until(clock::time_point t)
+{
+#ifdef __linux__
+    // steady_clock is CLOCK_MONOTONIC here, an absolute wake up doesn't
+    // drift when the thread is preempted before it sleeps
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    timespec ts = { (time_t)(ns / 1000000000), (long)(ns % 1000000000) };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+#else
+    // no clock_nanosleep on macOS, sleep for the remaining time instead
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t - clock::now()).count();
+
+    if (ns <= 0)
+        return;
+
+    timespec ts = { (time_t)(ns / 1000000000), (long)(ns % 1000000000) };
+
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+#endif
+}
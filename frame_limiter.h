@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Caps the frame rate by waiting out the rest of each frame period. Most
+// of the wait is an absolute sleep, the last stretch where the scheduler
+// can't be trusted to wake on time is a spin. A frame that overruns its
+// deadline counts as missed and the schedule restarts from there instead
+// of rushing to catch up.
+class FrameLimiter
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t frames;
+        uint64_t missed;
+        double mean_ms;     // frame time, wait included
+        double variance_ms; // of the frame time, in ms squared
+        double max_late_ms; // woken past the deadline
+    };
+
+    // target_hz of 0 disables the limit, stats are still kept
+    void init(double target_hz);
+
+    // blocks until the next frame is due
+    void wait();
+
+    bool enabled() const { return period.count() > 0; }
+    Stats stats() const;
+
+private:
+    void sleep_until(clock::time_point t);
+
+    clock::duration period{0};
+    clock::time_point deadline;
+    clock::time_point last_frame;
+    bool started = false;
+
+    uint64_t frames = 0;
+    uint64_t missed = 0;
+    // running mean and sum of squared differences of the frame time
+    double mean = 0.0;
+    double m2 = 0.0;
+    double max_late = 0.0;
+};
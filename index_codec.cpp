@@ -0,0 +1,142 @@
+#include "index_codec.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+const uint32_t INDEX_CODEC_MAGIC = 0x43584449; // "IDXC"
+
+struct IndexCodecHeader {
+    uint32_t magic;
+    uint32_t count;
+};
+
+std::vector<uint8_t> encode_indices(const uint32_t* indices, size_t count)
+{
+    std::vector<uint8_t> out(sizeof(IndexCodecHeader));
+    out.reserve(sizeof(IndexCodecHeader) + count * 2);
+
+    IndexCodecHeader header = { INDEX_CODEC_MAGIC, (uint32_t)count };
+    memcpy(out.data(), &header, sizeof(header));
+
+    uint32_t last = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t delta = (int32_t)(indices[i] - last);
+        uint32_t v = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        last = indices[i];
+
+        while (v >= 0x80) {
+            out.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((uint8_t)v);
+    }
+
+    return out;
+}
+
+size_t decoded_index_count(const uint8_t* data, size_t size)
+{
+    IndexCodecHeader header;
+
+    if (size < sizeof(header))
+        return 0;
+
+    memcpy(&header, data, sizeof(header));
+
+    return header.magic == INDEX_CODEC_MAGIC ? header.count : 0;
+}
+
+template <typename T>
+static bool decode(const uint8_t* data, size_t size, T* out)
+{
+    size_t count = decoded_index_count(data, size);
+    const uint8_t* p = data + sizeof(IndexCodecHeader);
+    const uint8_t* end = data + size;
+
+    uint32_t last = 0;
+    uint32_t overflow = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t v;
+
+        // single byte deltas are the common case
+        if (p < end && *p < 0x80) {
+            v = *p++;
+        }
+        else {
+            v = 0;
+            for (int shift = 0;; shift += 7) {
+                if (p == end || shift > 28)
+                    return false;
+
+                uint8_t b = *p++;
+                v |= (uint32_t)(b & 0x7f) << shift;
+
+                if (b < 0x80)
+                    break;
+            }
+        }
+
+        last += (v >> 1) ^ (0 - (v & 1));
+        overflow |= last;
+        out[i] = (T)last;
+    }
+
+    return sizeof(T) == sizeof(uint32_t) || overflow <= 0xffff;
+}
+
+bool decode_indices(const uint8_t* data, size_t size, uint16_t* out)
+{
+    return decode(data, size, out);
+}
+
+bool decode_indices(const uint8_t* data, size_t size, uint32_t* out)
+{
+    return decode(data, size, out);
+}
+
+bool write_index_file(const std::string& path, const std::vector<uint8_t>& encoded)
+{
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file)
+        return false;
+
+    file.write((const char*)encoded.data(), encoded.size());
+
+    return (bool)file;
+}
+
+bool read_index_file(const std::string& path, std::vector<uint8_t>& encoded)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+    if (!file)
+        return false;
+
+    encoded.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read((char*)encoded.data(), encoded.size());
+
+    return (bool)file && decoded_index_count(encoded.data(), encoded.size()) > 0;
+}
+
+IndexCodecStats measure_index_codec(const uint32_t* indices, size_t count, int iterations)
+{
+    std::vector<uint8_t> encoded = encode_indices(indices, count);
+    std::vector<uint32_t> decoded(count);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        decode_indices(encoded.data(), encoded.size(), decoded.data());
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    IndexCodecStats stats;
+    stats.raw_bytes = count * sizeof(uint32_t);
+    stats.encoded_bytes = encoded.size();
+    stats.indices_per_second = elapsed.count() > 0 ? (double)count * iterations / elapsed.count() : 0;
+
+    return stats;
+}
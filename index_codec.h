@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compressed index stream: a small header followed by the zigzag encoded
+// delta to the previous index, written as LEB128 varints. Triangle lists
+// from an optimized mesh mostly fit in one byte per index.
+
+struct IndexCodecStats {
+    size_t raw_bytes;
+    size_t encoded_bytes;
+    double indices_per_second;
+};
+
+std::vector<uint8_t> encode_indices(const uint32_t* indices, size_t count);
+
+// returns 0 if data is not a valid index stream
+size_t decoded_index_count(const uint8_t* data, size_t size);
+
+// out must hold decoded_index_count() entries. decoding to 16 bit fails
+// if any index does not fit
+bool decode_indices(const uint8_t* data, size_t size, uint16_t* out);
+bool decode_indices(const uint8_t* data, size_t size, uint32_t* out);
+
+bool write_index_file(const std::string& path, const std::vector<uint8_t>& encoded);
+bool read_index_file(const std::string& path, std::vector<uint8_t>& encoded);
+
+IndexCodecStats measure_index_codec(const uint32_t* indices, size_t count, int iterations);
@@ -0,0 +1,178 @@
+#include "input_log.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+const uint32_t INPUT_LOG_MAGIC = 0x4c504e49; // "INPL"
+const uint32_t INPUT_LOG_VERSION = 1;
+
+struct InputLogHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v)
+{
+    v = 0;
+
+    for (int shift = 0;; shift += 7) {
+        if (p == end || shift > 63)
+            return false;
+
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+
+        if (b < 0x80)
+            return true;
+    }
+}
+
+bool InputLogWriter::open(const std::string& path)
+{
+    file = fopen(path.c_str(), "wb");
+
+    if (!file)
+        return false;
+
+    InputLogHeader header = { INPUT_LOG_MAGIC, INPUT_LOG_VERSION };
+    fwrite(&header, sizeof(header), 1, file);
+
+    last_frame = 0;
+    last_timestamp = 0;
+
+    return true;
+}
+
+void InputLogWriter::write(const InputFrame& frame)
+{
+    buffer.clear();
+
+    uint32_t delta_bits;
+    memcpy(&delta_bits, &frame.delta_time, sizeof(delta_bits));
+
+    put_varint(buffer, frame.frame - last_frame);
+    buffer.insert(buffer.end(), (const uint8_t*)&delta_bits, (const uint8_t*)&delta_bits + sizeof(delta_bits));
+    put_varint(buffer, frame.events.size());
+
+    for (const InputEvent& e : frame.events) {
+        buffer.push_back((uint8_t)e.type);
+        put_varint(buffer, (uint64_t)e.scancode);
+        put_varint(buffer, zigzag(e.x_rel));
+        put_varint(buffer, zigzag(e.y_rel));
+        put_varint(buffer, zigzag((int64_t)e.timestamp - (int64_t)last_timestamp));
+
+        last_timestamp = e.timestamp;
+    }
+
+    last_frame = frame.frame;
+    fwrite(buffer.data(), 1, buffer.size(), file);
+}
+
+bool InputLogWriter::close()
+{
+    if (!file)
+        return false;
+
+    bool ok = fclose(file) == 0;
+    file = nullptr;
+
+    return ok;
+}
+
+bool read_input_log(const std::string& path, std::vector<InputFrame>& frames)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+        return false;
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    InputLogHeader header;
+
+    if (data.size() < sizeof(header))
+        return false;
+
+    memcpy(&header, data.data(), sizeof(header));
+
+    if (header.magic != INPUT_LOG_MAGIC || header.version != INPUT_LOG_VERSION)
+        return false;
+
+    const uint8_t* p = data.data() + sizeof(header);
+    const uint8_t* end = data.data() + data.size();
+
+    uint64_t frame = 0;
+    int64_t timestamp = 0;
+
+    frames.clear();
+
+    while (p < end) {
+        InputFrame f;
+        uint64_t frame_delta, count;
+
+        if (!get_varint(p, end, frame_delta) || end - p < 4)
+            return false;
+
+        uint32_t delta_bits;
+        memcpy(&delta_bits, p, sizeof(delta_bits));
+        memcpy(&f.delta_time, &delta_bits, sizeof(f.delta_time));
+        p += sizeof(delta_bits);
+
+        if (!get_varint(p, end, count))
+            return false;
+
+        frame += frame_delta;
+        f.frame = frame;
+
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t scancode, x, y, t;
+
+            if (p == end)
+                return false;
+
+            uint8_t type = *p++;
+
+            if (type > (uint8_t)InputEvent::Type::Window
+                    || !get_varint(p, end, scancode) || !get_varint(p, end, x)
+                    || !get_varint(p, end, y) || !get_varint(p, end, t)
+                    || scancode >= SDL_NUM_SCANCODES)
+                return false;
+
+            timestamp += unzigzag(t);
+
+            InputEvent e;
+            e.type = (InputEvent::Type)type;
+            e.scancode = (SDL_Scancode)scancode;
+            e.x_rel = (int32_t)unzigzag(x);
+            e.y_rel = (int32_t)unzigzag(y);
+            e.timestamp = (uint32_t)timestamp;
+            e.arrival_ns = 0;
+
+            f.events.push_back(e);
+        }
+
+        frames.push_back(std::move(f));
+    }
+
+    return true;
+}
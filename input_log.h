@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "input_manager.h"
+
+// Everything one InputManager::update() produced plus the frame's delta
+// time, enough to replay a session exactly.
+struct InputFrame {
+    uint64_t frame;
+    float delta_time;
+    std::vector<InputEvent> events;
+};
+
+// Log file: a small header, then per frame the frame index delta, the raw
+// delta time bits and the events, integers as LEB128 varints and signed
+// values zigzag encoded. Idle frames take 6 bytes.
+class InputLogWriter
+{
+public:
+    bool open(const std::string& path);
+    void write(const InputFrame& frame);
+    bool close();
+
+    bool is_open() const { return file != nullptr; }
+
+private:
+    FILE* file = nullptr;
+    uint64_t last_frame = 0;
+    uint32_t last_timestamp = 0;
+    std::vector<uint8_t> buffer;
+};
+
+bool read_input_log(const std::string& path, std::vector<InputFrame>& frames);
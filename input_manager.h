@@ -5,17 +5,36 @@
 #else
 #include <SDL2/SDL.h>
 #endif
-#include <map>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
 
-#define KEY_UP      SDLK_UP
-#define KEY_DOWN    SDLK_DOWN
-#define KEY_LEFT    SDLK_LEFT
-#define KEY_RIGHT   SDLK_RIGHT
-#define KEY_QUIT    SDLK_ESCAPE
-#define KEY_RESTART SDLK_r
+#include "spsc_ring.h"
 
-struct keyState {
-    bool pressed, held, released;
+// keys are physical scancodes, independent of keyboard layout
+#define KEY_UP      SDL_SCANCODE_UP
+#define KEY_DOWN    SDL_SCANCODE_DOWN
+#define KEY_LEFT    SDL_SCANCODE_LEFT
+#define KEY_RIGHT   SDL_SCANCODE_RIGHT
+#define KEY_QUIT    SDL_SCANCODE_ESCAPE
+#define KEY_RESTART SDL_SCANCODE_R
+#define KEY_LOD     SDL_SCANCODE_L
+
+struct InputEvent {
+    enum class Type : uint8_t {
+        KeyDown,
+        KeyUp,
+        MouseMotion,
+        Quit,
+        Window, // shown, resized or exposed, the contents need a redraw
+    };
+
+    Type type;
+    SDL_Scancode scancode;
+    int32_t x_rel, y_rel;
+    uint32_t timestamp; // SDL ticks in ms
+    uint64_t arrival_ns; // steady clock when the event reached us
 };
 
 class InputManager
@@ -30,48 +49,73 @@ public:
 
     void update()
     {
-        SDL_Event event;
-
-        mouse_x_rel = 0;
-        mouse_y_rel = 0;
-
-        while (SDL_PollEvent(&event) != 0) {
-            switch (event.type) {
-            case SDL_QUIT:
-                quit = true;
-                break;
-            case SDL_KEYDOWN:
-                new_keystate[event.key.keysym.sym] = true;
-                break;
-            case SDL_KEYUP:
-                new_keystate[event.key.keysym.sym] = false;
-                break;
-            case SDL_MOUSEMOTION:
-                mouse_x_rel += event.motion.xrel;
-                mouse_y_rel += event.motion.yrel;
-                break;
-            default:
-                break;
-            }
-        }
+        collect();
+        end_frame();
+    }
 
-        for (auto& [idx, k_state] : k_states) {
-            k_state.pressed = false;
-            k_state.released = false;
-
-            if (new_keystate[idx] != old_keystate[idx]) {
-                if (new_keystate[idx] == true) {
-                    k_state.pressed = !k_state.held;
-                    k_state.held = true;
-                }
-                else {
-                    k_state.released = true;
-                    k_state.held = false;
-                }
-            }
+    // takes in new events mid frame so is_down() is current, they still
+    // count towards the next update()
+    void latch()
+    {
+        collect();
+    }
+
+    // feeds recorded events instead of live input. SDL is still pumped
+    // to keep the window responsive, but what it delivers is dropped
+    void replay(const std::vector<InputEvent>& recorded)
+    {
+        SDL_PumpEvents();
+        SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
 
-            old_keystate[idx] = new_keystate[idx];
+        for (InputEvent e : recorded) {
+            e.arrival_ns = now_ns();
+            apply(e);
         }
+
+        end_frame();
+    }
+
+    // Events are taken as SDL receives them, including ones pushed from
+    // other threads, instead of when update() polls. They are timestamped
+    // on arrival and handed over through a lock-free ring. SDL runs event
+    // watchers one at a time, so the ring has a single producer.
+    void enable_event_watch()
+    {
+        if (watching)
+            return;
+
+        watching = true;
+        SDL_AddEventWatch(event_watch, this);
+    }
+
+    void disable_event_watch()
+    {
+        if (!watching)
+            return;
+
+        SDL_DelEventWatch(event_watch, this);
+        watching = false;
+    }
+
+    // arrival times of the events taken in since the last call, when
+    // tracked, for measuring how long input takes to have an effect
+    void track_arrivals(bool enable)
+    {
+        tracking_arrivals = enable;
+        arrivals.clear();
+    }
+
+    void take_arrivals(std::vector<uint64_t>& out)
+    {
+        out.insert(out.end(), arrivals.begin(), arrivals.end());
+        arrivals.clear();
+    }
+
+    // events of the last update in the order they happened, so a press
+    // and release within one frame can still be told apart
+    const std::vector<InputEvent>& frame_events() const
+    {
+        return events;
     }
 
     bool quit_requested()
@@ -81,17 +125,35 @@ public:
 
     bool is_held(int k)
     {
-        return k_states[k].held;
+        return test(held, k);
+    }
+
+    // blocks until an event is queued or timeout_ms pass, the event is
+    // left for update()
+    bool wait_event(int timeout_ms)
+    {
+        return SDL_WaitEventTimeout(nullptr, timeout_ms) == 1;
+    }
+
+    bool window_changed()
+    {
+        return window_dirty;
+    }
+
+    // held as of the latest update() or latch()
+    bool is_down(int k)
+    {
+        return test(current, k);
     }
 
     bool is_pressed(int k)
     {
-        return k_states[k].pressed;
+        return test(pressed, k);
     }
 
     bool is_released(int k)
     {
-        return k_states[k].released;
+        return test(released, k);
     }
 
     float mouse_x()
@@ -105,13 +167,210 @@ public:
     }
 
 private:
+    static const int WORDS = (SDL_NUM_SCANCODES + 63) / 64;
+    static const size_t RING_SIZE = 4096;
+
     InputManager() {}
 
+    static uint64_t now_ns()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static int event_watch(void* data, SDL_Event* event)
+    {
+        InputManager* self = (InputManager*)data;
+        InputEvent e;
+
+        if (!translate(*event, e))
+            return 0;
+
+        // a full ring spills to a locked list rather than lose events,
+        // later events follow until it is drained to keep the order
+        if (!self->spilling.load(std::memory_order_acquire) && self->ring.push(e))
+            return 0;
+
+        std::lock_guard<std::mutex> lock(self->spill_mutex);
+        self->spill.push_back(e);
+        self->spilling.store(true, std::memory_order_release);
+
+        return 0;
+    }
+
+    void drain_watched()
+    {
+        InputEvent e;
+
+        while (ring.pop(e))
+            apply(e);
+
+        if (!spilling.load(std::memory_order_acquire))
+            return;
+
+        std::vector<InputEvent> spilled;
+        {
+            std::lock_guard<std::mutex> lock(spill_mutex);
+            spilled.swap(spill);
+            spilling.store(false, std::memory_order_release);
+        }
+
+        // anything pushed to the ring from here on is newer, it waits for
+        // the next update
+        for (const InputEvent& s : spilled)
+            apply(s);
+    }
+
+    static bool test(const uint64_t* bits, int k)
+    {
+        return k >= 0 && k < SDL_NUM_SCANCODES && (bits[k >> 6] >> (k & 63)) & 1;
+    }
+
+    static void set(uint64_t* bits, int k, bool value)
+    {
+        if (k < 0 || k >= SDL_NUM_SCANCODES)
+            return;
+
+        uint64_t mask = 1ull << (k & 63);
+        bits[k >> 6] = value ? bits[k >> 6] | mask : bits[k >> 6] & ~mask;
+    }
+
+    void collect()
+    {
+        if (watching) {
+            // the watch has already seen everything pumped or pushed
+            SDL_PumpEvents();
+            SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+            drain_watched();
+        }
+        else {
+            SDL_Event event;
+            InputEvent e;
+
+            while (SDL_PollEvent(&event) != 0) {
+                if (translate(event, e))
+                    apply(e);
+            }
+        }
+    }
+
+    static bool translate(const SDL_Event& event, InputEvent& e)
+    {
+        e = { InputEvent::Type::Quit, SDL_SCANCODE_UNKNOWN, 0, 0, event.common.timestamp, now_ns() };
+
+        switch (event.type) {
+        case SDL_QUIT:
+            return true;
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            // auto repeat is not a new press
+            if (event.key.repeat)
+                return false;
+
+            e.type = event.type == SDL_KEYDOWN ? InputEvent::Type::KeyDown : InputEvent::Type::KeyUp;
+            e.scancode = event.key.keysym.scancode;
+            return true;
+        case SDL_MOUSEMOTION:
+            e.type = InputEvent::Type::MouseMotion;
+            e.x_rel = event.motion.xrel;
+            e.y_rel = event.motion.yrel;
+            return true;
+        case SDL_WINDOWEVENT:
+            switch (event.window.event) {
+            case SDL_WINDOWEVENT_SHOWN:
+            case SDL_WINDOWEVENT_EXPOSED:
+            case SDL_WINDOWEVENT_SIZE_CHANGED:
+            case SDL_WINDOWEVENT_RESTORED:
+                e.type = InputEvent::Type::Window;
+                return true;
+            default:
+                return false;
+            }
+        default:
+            return false;
+        }
+    }
+
+    void apply(const InputEvent& e)
+    {
+        switch (e.type) {
+        case InputEvent::Type::Quit:
+            quit = true;
+            break;
+        case InputEvent::Type::KeyDown:
+        case InputEvent::Type::KeyUp: {
+            bool down = e.type == InputEvent::Type::KeyDown;
+
+            set(current, e.scancode, down);
+            set(down ? down_seen : up_seen, e.scancode, true);
+            break;
+        }
+        case InputEvent::Type::MouseMotion:
+            pending_mouse_x += e.x_rel;
+            pending_mouse_y += e.y_rel;
+            break;
+        case InputEvent::Type::Window:
+            pending_window_dirty = true;
+            break;
+        }
+
+        if (tracking_arrivals)
+            arrivals.push_back(e.arrival_ns);
+
+        pending_events.push_back(e);
+    }
+
+    // whole words at a time, a key both pressed and released within the
+    // frame shows up in both
+    void end_frame()
+    {
+        for (int w = 0; w < WORDS; w++) {
+            uint64_t changed = current[w] ^ held[w];
+            uint64_t tapped = down_seen[w] & up_seen[w];
+
+            pressed[w] = (changed & current[w]) | tapped;
+            released[w] = (changed & held[w]) | tapped;
+            held[w] = current[w];
+
+            down_seen[w] = 0;
+            up_seen[w] = 0;
+        }
+
+        events.swap(pending_events);
+        pending_events.clear();
+
+        mouse_x_rel = pending_mouse_x;
+        mouse_y_rel = pending_mouse_y;
+        pending_mouse_x = 0;
+        pending_mouse_y = 0;
+
+        window_dirty = pending_window_dirty;
+        pending_window_dirty = false;
+    }
+
     bool quit = false;
     int mouse_state = 0;
     int mouse_x_rel = 0, mouse_y_rel = 0;
+    int pending_mouse_x = 0, pending_mouse_y = 0;
+    bool window_dirty = false, pending_window_dirty = false;
+
+    // current follows the events, the others are per update
+    uint64_t current[WORDS] = {};
+    uint64_t held[WORDS] = {};
+    uint64_t pressed[WORDS] = {};
+    uint64_t released[WORDS] = {};
+    uint64_t down_seen[WORDS] = {};
+    uint64_t up_seen[WORDS] = {};
+
+    std::vector<InputEvent> events;
+    std::vector<InputEvent> pending_events;
+
+    bool watching = false;
+    SpscRing<InputEvent, RING_SIZE> ring;
+    std::atomic<bool> spilling{false};
+    std::mutex spill_mutex;
+    std::vector<InputEvent> spill;
 
-    std::map<SDL_Keycode, bool> new_keystate;
-    std::map<SDL_Keycode, bool> old_keystate;
-    std::map<SDL_Keycode, keyState> k_states;
+    bool tracking_arrivals = false;
+    std::vector<uint64_t> arrivals;
 };
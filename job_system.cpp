@@ -0,0 +1,256 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static thread_local const JobSystem* tls_system = nullptr;
+static thread_local uint32_t tls_worker = 0;
+
+bool JobDeque::push(Job* job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+
+    if (b - t >= CAPACITY)
+        return false;
+
+    jobs[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);
+
+    return true;
+}
+
+Job* JobDeque::pop()
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_seq_cst);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+
+    // last job, race the thieves for it
+    if (t == b) {
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+Job* JobDeque::steal()
+{
+    int64_t t = top.load(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_seq_cst);
+
+    if (t >= b)
+        return nullptr;
+
+    Job* job = jobs[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+
+    return job;
+}
+
+void JobSystem::init(uint32_t thread_count)
+{
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    quit = false;
+    tls_system = this;
+    tls_worker = 0;
+
+    for (uint32_t i = 0; i < thread_count; i++)
+        workers.push_back(new Worker());
+
+    for (uint32_t i = 1; i < thread_count; i++)
+        workers[i]->thread = std::thread(&JobSystem::worker_main, this, i);
+}
+
+void JobSystem::cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        quit = true;
+    }
+    sleep_cv.notify_all();
+
+    for (Worker* worker : workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+
+    // nothing should be left queued, run stragglers rather than leak them
+    for (Worker* worker : workers) {
+        while (Job* job = worker->deque.pop())
+            execute(job);
+
+        delete worker;
+    }
+
+    while (Job* job = take_injected())
+        execute(job);
+
+    workers.clear();
+
+    if (tls_system == this)
+        tls_system = nullptr;
+}
+
+uint32_t JobSystem::current_worker() const
+{
+    return tls_system == this ? tls_worker : FOREIGN_THREAD;
+}
+
+void JobSystem::run(std::function<void()> func, JobCounter* counter)
+{
+    Job* job = new Job{ std::move(func), counter };
+
+    if (counter)
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t index = current_worker();
+
+    if (index == FOREIGN_THREAD) {
+        std::lock_guard<std::mutex> lock(inject_mutex);
+        injected.push_back(job);
+        injected_count.fetch_add(1, std::memory_order_release);
+    }
+    else if (!workers[index]->deque.push(job)) {
+        execute(job);
+        return;
+    }
+
+    queued.fetch_add(1, std::memory_order_seq_cst);
+
+    if (sleeping.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        sleep_cv.notify_one();
+    }
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    uint32_t index = current_worker();
+
+    while (counter.value.load(std::memory_order_acquire) != 0) {
+        if (Job* job = find_job(index))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+// own deque first, then injected jobs, then the other deques. Foreign
+// threads can only take injected jobs and steal
+Job* JobSystem::find_job(uint32_t index)
+{
+    bool foreign = index == FOREIGN_THREAD;
+    Job* job = foreign ? nullptr : workers[index]->deque.pop();
+
+    if (!job)
+        job = take_injected();
+
+    uint32_t first = foreign ? 0 : index + 1;
+    uint32_t count = foreign ? (uint32_t)workers.size() : (uint32_t)workers.size() - 1;
+
+    for (uint32_t i = 0; !job && i < count; i++)
+        job = workers[(first + i) % workers.size()]->deque.steal();
+
+    if (job)
+        queued.fetch_sub(1, std::memory_order_relaxed);
+
+    return job;
+}
+
+Job* JobSystem::take_injected()
+{
+    if (injected_count.load(std::memory_order_acquire) == 0)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(inject_mutex);
+
+    if (injected.empty())
+        return nullptr;
+
+    Job* job = injected.front();
+    injected.pop_front();
+    injected_count.fetch_sub(1, std::memory_order_relaxed);
+
+    return job;
+}
+
+void JobSystem::execute(Job* job)
+{
+    job->func();
+
+    if (job->counter)
+        job->counter->value.fetch_sub(1, std::memory_order_release);
+
+    delete job;
+}
+
+void JobSystem::worker_main(uint32_t index)
+{
+    tls_system = this;
+    tls_worker = index;
+
+    while (!quit.load(std::memory_order_acquire)) {
+        if (Job* job = find_job(index)) {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        sleep_cv.wait(lock, [this] {
+            return quit.load(std::memory_order_acquire) || queued.load(std::memory_order_seq_cst) > 0;
+        });
+        sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+std::vector<double> measure_job_scaling(uint32_t max_threads, size_t items)
+{
+    std::vector<float> data(items);
+    std::vector<double> speedup;
+    double single_ms = 0.0;
+
+    for (uint32_t threads = 1; threads <= max_threads; threads++) {
+        JobSystem jobs;
+        jobs.init(threads);
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (int iteration = 0; iteration < 10; iteration++) {
+            jobs.parallel_for(items, 1024, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    float x = (float)i;
+                    for (int k = 0; k < 64; k++)
+                        x = std::sqrt(x * 1.0001f + 1.0f);
+                    data[i] = x;
+                }
+            });
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        jobs.cleanup();
+
+        if (threads == 1)
+            single_ms = elapsed.count();
+
+        speedup.push_back(single_ms / elapsed.count());
+    }
+
+    return speedup;
+}
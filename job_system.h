@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of jobs still outstanding. A job passed a counter increments it
+// when queued and decrements it when done, wait() returns at zero.
+struct JobCounter {
+    std::atomic<uint32_t> value{0};
+};
+
+struct Job {
+    std::function<void()> func;
+    JobCounter* counter;
+};
+
+// Chase-Lev work stealing deque. The owning thread pushes and pops at
+// the bottom, other threads steal from the top. Fixed capacity, push
+// fails when full.
+class JobDeque
+{
+public:
+    static const int64_t CAPACITY = 4096;
+
+    bool push(Job* job);
+    Job* pop();
+    Job* steal();
+
+private:
+    std::atomic<int64_t> top{0};
+    std::atomic<int64_t> bottom{0};
+    std::atomic<Job*> jobs[CAPACITY];
+};
+
+// Worker threads plus the thread that called init(), which is worker 0
+// and helps out while it waits. Jobs are pushed to the calling worker's
+// deque, idle workers steal from the others. Other threads may not touch
+// a deque's bottom, their jobs go through a locked injection queue.
+class JobSystem
+{
+public:
+    // thread_count includes the calling thread, 0 picks the core count
+    void init(uint32_t thread_count = 0);
+    void cleanup();
+
+    void run(std::function<void()> func, JobCounter* counter);
+
+    // runs other jobs until counter reaches zero
+    void wait(JobCounter& counter);
+
+    // calls func(begin, end) over [0, count) in ranges of about grain
+    // items, and waits for all of them
+    template <typename F>
+    void parallel_for(size_t count, size_t grain, const F& func)
+    {
+        grain = grain > 0 ? grain : 1;
+
+        if (count <= grain || workers.size() <= 1) {
+            if (count > 0)
+                func((size_t)0, count);
+            return;
+        }
+
+        JobCounter counter;
+
+        for (size_t begin = grain; begin < count; begin += grain) {
+            size_t end = begin + grain < count ? begin + grain : count;
+            run([&func, begin, end] { func(begin, end); }, &counter);
+        }
+
+        func((size_t)0, grain);
+        wait(counter);
+    }
+
+    uint32_t thread_count() const { return (uint32_t)workers.size(); }
+
+private:
+    struct Worker {
+        JobDeque deque;
+        std::thread thread;
+    };
+
+    // current_worker() of threads the system did not start
+    static const uint32_t FOREIGN_THREAD = UINT32_MAX;
+
+    void worker_main(uint32_t index);
+    Job* find_job(uint32_t index);
+    Job* take_injected();
+    void execute(Job* job);
+    uint32_t current_worker() const;
+
+    // heap allocated so deques don't move
+    std::vector<Worker*> workers;
+
+    std::mutex inject_mutex;
+    std::deque<Job*> injected;
+    std::atomic<uint32_t> injected_count{0};
+
+    std::atomic<bool> quit{false};
+    std::atomic<uint32_t> queued{0};
+    std::atomic<uint32_t> sleeping{0};
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+};
+
+// parallel_for speedup over a fixed synthetic workload at 1..max_threads
+std::vector<double> measure_job_scaling(uint32_t max_threads, size_t items);
@@ -1,13 +1,27 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
 
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/euler_angles.hpp>
 
+#include "frame_limiter.h"
+#include "input_log.h"
+#include "job_system.h"
+#include "profiler.h"
 #include "renderer.h"
+#include "simulation.h"
+#include "triple_buffer.h"
 
 #include "input_manager.h"
 #include "camera.h"
@@ -15,96 +29,470 @@
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 
-struct Model {
-    glm::vec3 translate;
-    glm::vec3 rotate;
-    glm::vec3 scale;
+const char* PROFILE_TRACE_PATH = "trace.json";
+// longest an on demand frame loop sleeps waiting for input
+const int ON_DEMAND_WAIT_MS = 1000;
 
-    glm::mat4 model_mat()
-    {
-        glm::mat4 model = glm::mat4(1.0f);
-        glm::mat4 rot = glm::eulerAngleZYX(rotate.z, rotate.y, rotate.x);
-        model = glm::translate(model, translate);
-        model *= rot;
-        model = glm::scale(model, scale);
+// the last two simulation ticks, rendering lands between them
+struct FrameSnapshot {
+    uint64_t tick;
+    std::chrono::steady_clock::time_point time; // of the current tick
+    SimState previous;
+    SimState current;
+};
 
-        return model;
-    }
+// command line options
+struct AppOptions {
+    bool threaded = false;
+    float render_load_ms = 0.0f;
+    bool input_watch = false;
+    bool late_latch = false;
+    double fps_limit = 0.0;
+    bool on_demand = false;
+    size_t views = 1;
+    std::string record_path;
+    std::string replay_path;
 };
 
 class Application
 {
 public:
-    Application() : quit(false), delta_time(0.0f)
+    Application(const AppOptions& options)
+        : quit(false)
+        , delta_time(0.0f)
+        , accumulator(0.0)
+        , options(options)
+        , replay_index(0)
+        , frame_count(0)
+        , view_hash(0)
+        , redraw_requested(true)
     {
-        triangle.translate = glm::vec3(0.0f, 0.0f, 0.0f);
-        triangle.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        triangle.rotate = glm::vec3(0.0f, 0.0f, glm::half_pi<float>());
+        current.triangle.translate = glm::dvec3(0.0, 0.0, 0.0);
+        current.triangle.scale = glm::vec3(1.0f, 1.0f, 1.0f);
+        current.triangle.rotate = glm::vec3(0.0f, 0.0f, glm::half_pi<float>());
+        current.camera.set_projection((float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 1000.0f);
+        previous = current;
     }
 
     int run(Renderer* renderer)
     {
-        renderer->init();
+#ifdef PROFILE
+        if (!Profiler::instance().open_trace(PROFILE_TRACE_PATH))
+            std::cerr << "Failed to open " << PROFILE_TRACE_PATH << "\n";
+#endif
 
-        while (!quit) {
-            delta_time = renderer->frame_start();
+        jobs.init();
+        renderer->init(jobs);
 
-            input_mgr.update();
-            process_input();
+        // each view gets a tile of the window
+        current.camera.set_projection(renderer->view_aspect(), 0.1f, 1000.0f);
+        previous = current;
 
-            {
-                glm::mat4 p = glm::perspective(camera.zoom(), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 1000.0f);
-                glm::mat4 v = camera.look_at();
-                glm::mat4 m = triangle.model_mat();
-                ubo_data.mvp = p * v * m;
-                renderer->update_uniform(&ubo_data);
+        // replays must step exactly like the recording did
+        if (options.threaded && (!options.record_path.empty() || !options.replay_path.empty())) {
+            std::cout << "input recording and replay run single threaded\n";
+            options.threaded = false;
+        }
+
+        // a replay never delivers the input an idle loop waits for
+        if (options.on_demand && (!options.record_path.empty() || !options.replay_path.empty())) {
+            std::cout << "on demand redraw is off while recording or replaying\n";
+            options.on_demand = false;
+        }
+
+        if (options.on_demand && options.threaded) {
+            std::cout << "on demand redraw runs single threaded\n";
+            options.threaded = false;
+        }
+
+        // the latched view depends on when input arrives, which a replay
+        // can't reproduce
+        if (options.late_latch && (!options.record_path.empty() || !options.replay_path.empty())) {
+            std::cout << "late latch is off while recording or replaying\n";
+            options.late_latch = false;
+        }
 
+        if (!options.replay_path.empty()) {
+            if (!read_input_log(options.replay_path, replay_frames)) {
+                std::cerr << "Failed to read input log " << options.replay_path << "\n";
+                exit(EXIT_FAILURE);
             }
-            renderer->draw();
         }
+        else if (!options.record_path.empty()) {
+            if (!input_log.open(options.record_path)) {
+                std::cerr << "Failed to open input log " << options.record_path << "\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (options.input_watch) {
+            input_mgr.enable_event_watch();
+        }
+
+        input_mgr.track_arrivals(true);
+        limiter.init(options.fps_limit);
+
+        if (options.threaded)
+            run_threaded(renderer);
+        else
+            run_single(renderer);
+
+        // arrival is when SDL received the event with --input-watch,
+        // otherwise when it was polled
+        std::sort(commit_latencies.begin(), commit_latencies.end());
+        std::cout << "input to commit latency (late latch " << (options.late_latch ? "on" : "off") << "): "
+                  << commit_latencies.size() << " events, p50 " << percentile_ms(commit_latencies, 0.5)
+                  << " ms p99 " << percentile_ms(commit_latencies, 0.99) << " ms\n";
 
+        FrameLimiter::Stats pacing = limiter.stats();
+        std::cout << "pacing: " << pacing.frames << " frames, frame time " << pacing.mean_ms << " ms stddev "
+                  << std::sqrt(pacing.variance_ms) << " ms";
+        if (limiter.enabled())
+            std::cout << ", " << pacing.missed << " missed deadlines at " << options.fps_limit
+                      << " fps, woke up to " << pacing.max_late_ms << " ms late";
+        std::cout << "\n";
+
+        input_mgr.disable_event_watch();
+        input_log.close();
         renderer->cleanup();
+        jobs.cleanup();
+
+#ifdef PROFILE
+        Profiler& profiler = Profiler::instance();
+        if (profiler.close_trace())
+            std::cout << "profile: trace written to " << PROFILE_TRACE_PATH << ", "
+                      << profiler.dropped_events() << " events dropped\n";
+        else
+            std::cerr << "Failed to write " << PROFILE_TRACE_PATH << "\n";
+#endif
 
         return 0;
     }
 
 private:
-    void process_input()
+    void run_single(Renderer* renderer)
+    {
+        uint64_t rendered = 0;
+        auto start = std::chrono::steady_clock::now();
+        rusage usage_start;
+        getrusage(RUSAGE_SELF, &usage_start);
+
+        while (!quit) {
+            // with nothing moving or held there is nothing new to draw
+            // until some input arrives
+            bool idle = options.on_demand && !redraw_requested && !previous.dirty() && !current.dirty()
+                && held_actions(input_mgr) == 0;
+
+            if (idle) {
+                PROFILE_SCOPE("wait for input");
+                input_mgr.wait_event(ON_DEMAND_WAIT_MS);
+            }
+
+            limiter.wait();
+            delta_time = renderer->frame_start();
+
+            {
+                PROFILE_SCOPE("input");
+                poll_input();
+                process_input(renderer);
+            }
+
+            // fixed steps for whatever time passed, the remainder is how far
+            // rendering is into the next step. Time spent idle had nothing
+            // to simulate
+            if (idle)
+                accumulator = 0.0;
+            int steps = fixed_steps(accumulator, idle ? 0.0 : delta_time);
+
+            uint32_t held = held_actions(input_mgr);
+            {
+                PROFILE_SCOPE("simulate");
+                for (int i = 0; i < steps; i++)
+                    step(held);
+            }
+
+            frame_count++;
+
+            // the view moves while either of the last two ticks changed
+            // something
+            if (options.on_demand && !redraw_requested && !previous.dirty() && !current.dirty()) {
+                PROFILE_FRAME();
+                continue;
+            }
+
+            float alpha = (float)(accumulator / SIM_TIMESTEP);
+            SimState state = previous.interpolate(current, alpha);
+            FrameView v = frame_view(state, options.views);
+            render(renderer, v, state);
+            redraw_requested = false;
+            rendered++;
+
+            view_hash = hash_frame_view(v, view_hash);
+
+            PROFILE_FRAME();
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        rusage usage_end;
+        getrusage(RUSAGE_SELF, &usage_end);
+
+        std::cout << "frames: " << rendered << " rendered of " << frame_count << " loops in " << elapsed.count()
+                  << " s" << (options.on_demand ? " (on demand)" : "") << ", cpu "
+                  << 100.0 * cpu_seconds(usage_start, usage_end) / elapsed.count() << "%\n";
+
+        if (!options.record_path.empty() || !options.replay_path.empty()) {
+            const Camera& camera = current.camera;
+
+            std::cout << std::setprecision(9) << "session: " << frame_count << " frames, view hash "
+                      << std::hex << view_hash << std::dec << ", camera " << camera.position().x << " "
+                      << camera.position().y << " " << camera.position().z << " yaw " << camera.yaw()
+                      << " pitch " << camera.pitch() << std::setprecision(6) << "\n";
+        }
+    }
+
+    // live input, written to the log when recording, or the next recorded
+    // frame with its original delta time when replaying
+    void poll_input()
+    {
+        if (!options.replay_path.empty()) {
+            if (replay_index == replay_frames.size()) {
+                input_mgr.replay({});
+                quit = true;
+                return;
+            }
+
+            const InputFrame& frame = replay_frames[replay_index++];
+            delta_time = frame.delta_time;
+            input_mgr.replay(frame.events);
+            return;
+        }
+
+        input_mgr.update();
+
+        if (input_log.is_open())
+            input_log.write({ frame_count, delta_time, input_mgr.frame_events() });
+    }
+
+    // simulation ticks at a fixed rate on its own thread and publishes
+    // snapshots, this thread polls input and draws the newest snapshot
+    void run_threaded(Renderer* renderer)
+    {
+        snapshots.write_buffer() = { 0, std::chrono::steady_clock::now(), previous, current };
+        snapshots.publish();
+        snapshots.update();
+
+        sim_quit = false;
+        std::thread sim_thread(&Application::simulation_main, this);
+
+        uint64_t frames = 0;
+        uint64_t fresh_frames = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        while (!quit) {
+            limiter.wait();
+            renderer->frame_start();
+
+            {
+                PROFILE_SCOPE("input");
+                input_mgr.update();
+                process_input(renderer);
+            }
+            actions.store(held_actions(input_mgr), std::memory_order_relaxed);
+
+            if (snapshots.update())
+                fresh_frames++;
+
+            // one tick behind, interpolated by the time since the last tick
+            const FrameSnapshot& s = snapshots.read_buffer();
+            std::chrono::duration<double> since = std::chrono::steady_clock::now() - s.time;
+            float alpha = (float)std::min(since.count() / SIM_TIMESTEP, 1.0);
+
+            SimState state = s.previous.interpolate(s.current, alpha);
+            render(renderer, view(state), state);
+            frames++;
+
+            PROFILE_FRAME();
+        }
+
+        sim_quit = true;
+        sim_thread.join();
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "simulation: " << sim_ticks << " ticks at " << 1.0 / SIM_TIMESTEP << " Hz, jitter avg "
+                  << (sim_ticks > 1 ? sim_jitter_total / (sim_ticks - 1) : 0.0) * 1000 << " ms max "
+                  << sim_jitter_max * 1000 << " ms, " << sim_skipped << " skipped\n";
+        std::cout << "render: " << frames << " frames in " << elapsed.count() << " s ("
+                  << frames / elapsed.count() << " fps), " << fresh_frames << " with a new snapshot\n";
+    }
+
+    void simulation_main()
+    {
+        using clock = std::chrono::steady_clock;
+
+        clock::duration tick_length = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(SIM_TIMESTEP));
+        clock::time_point next = clock::now();
+        clock::time_point last = next;
+
+        while (!sim_quit.load(std::memory_order_acquire)) {
+            next += tick_length;
+            std::this_thread::sleep_until(next);
+
+            clock::time_point now = clock::now();
+
+            // far behind after a stall, drop the missed ticks
+            if (now - next > tick_length * SIM_MAX_CATCH_UP) {
+                sim_skipped += (now - next) / tick_length;
+                next = now;
+            }
+
+            if (sim_ticks > 0) {
+                double jitter = std::abs(std::chrono::duration<double>(now - last).count() - SIM_TIMESTEP);
+                sim_jitter_total += jitter;
+                sim_jitter_max = std::max(sim_jitter_max, jitter);
+            }
+            last = now;
+
+            PROFILE_SCOPE("simulate");
+            step(actions.load(std::memory_order_relaxed));
+
+            snapshots.write_buffer() = { ++sim_ticks, now, previous, current };
+            snapshots.publish();
+        }
+    }
+
+    void process_input(Renderer* renderer)
     {
         if (input_mgr.quit_requested() || input_mgr.is_pressed(KEY_QUIT)) {
             quit = true;
         }
 
-        if (input_mgr.is_held(KEY_UP)) {
-            camera.process_keyboard(CameraDirection::FORWARD, delta_time);
+        if (input_mgr.is_pressed(KEY_LOD)) {
+            renderer->toggle_lod();
+            redraw_requested = true;
         }
 
-        if (input_mgr.is_held(KEY_DOWN)) {
-            camera.process_keyboard(CameraDirection::BACKWARD, delta_time);
+        if (input_mgr.window_changed()) {
+            redraw_requested = true;
         }
+    }
+
+    void step(uint32_t held)
+    {
+        simulation_step(previous, current, held);
+    }
+
+    // state is what the view was computed from, late latching carries it
+    // forward to the commit with the input taken in meanwhile
+    void render(Renderer* renderer, const FrameView& s, const SimState& state)
+    {
+        auto sampled = std::chrono::steady_clock::now();
+        renderer->select_lod(s.lod_distance, s.fov_y);
 
-        if (input_mgr.is_held(KEY_LEFT)) {
-            triangle.rotate.z += 0.05;
+        for (size_t i = 0; i < s.view_count; i++)
+            ubo_data[i].mvp = s.mvp[i];
+        renderer->update_uniforms(ubo_data, s.view_count);
+        renderer->update_visibility(s.mvp, s.object_camera, s.view_count);
+
+        // stand in for a heavy frame, to see the simulation keep its rate
+        if (options.render_load_ms > 0.0f)
+            std::this_thread::sleep_for(std::chrono::duration<float, std::milli>(options.render_load_ms));
+
+        if (options.late_latch) {
+            // culling and LOD keep the earlier view, the latched one is
+            // only a frame's worth of movement away
+            renderer->draw([this, &state, sampled](UBO_VS* ubo) {
+                input_mgr.latch();
+
+                SimState latched = state;
+                std::chrono::duration<float> since = std::chrono::steady_clock::now() - sampled;
+                simulate(latched, held_actions(input_mgr, true), since.count());
+                FrameView v = frame_view(latched, options.views);
+                for (size_t i = 0; i < v.view_count; i++)
+                    ubo[i].mvp = v.mvp[i];
+            });
         }
-        else if (input_mgr.is_held(KEY_RIGHT)) {
-            triangle.rotate.z -= 0.05;
+        else {
+            renderer->draw();
         }
+
+        uint64_t commit_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                renderer->commit_time().time_since_epoch()).count();
+
+        arrivals.clear();
+        input_mgr.take_arrivals(arrivals);
+
+        for (uint64_t arrival : arrivals)
+            commit_latencies.push_back(commit_ns - arrival);
     }
 
     InputManager &input_mgr = InputManager::instance();
+    JobSystem jobs;
+    FrameLimiter limiter;
 
     bool quit;
     float delta_time;
+    double accumulator;
+    AppOptions options;
 
-    Camera camera;
-    Model triangle;
-    UBO_VS ubo_data;
+    InputLogWriter input_log;
+    std::vector<InputFrame> replay_frames;
+    size_t replay_index;
+    uint64_t frame_count;
+    uint64_t view_hash;
+    // something besides the simulation changed what's on screen
+    bool redraw_requested;
+
+    std::vector<uint64_t> arrivals;
+    std::vector<uint64_t> commit_latencies;
+
+    // simulation state at the last two ticks, owned by the simulation
+    // thread in threaded mode
+    SimState previous;
+    SimState current;
+    UBO_VS ubo_data[MAX_VIEWS];
+
+    // threaded mode
+    TripleBuffer<FrameSnapshot> snapshots;
+    std::atomic<uint32_t> actions{0};
+    std::atomic<bool> sim_quit{false};
+    uint64_t sim_ticks = 0;
+    uint64_t sim_skipped = 0;
+    double sim_jitter_total = 0.0;
+    double sim_jitter_max = 0.0;
 };
 
 int main(int argc, char** argv)
 {
+    AppOptions options;
+    double target_frame_ms = 0.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threaded") == 0)
+            options.threaded = true;
+        else if (strcmp(argv[i], "--render-load-ms") == 0 && i + 1 < argc)
+            options.render_load_ms = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--input-watch") == 0)
+            options.input_watch = true;
+        else if (strcmp(argv[i], "--late-latch") == 0)
+            options.late_latch = true;
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            options.fps_limit = atof(argv[++i]);
+        else if (strcmp(argv[i], "--on-demand") == 0)
+            options.on_demand = true;
+        else if (strcmp(argv[i], "--target-frame-ms") == 0 && i + 1 < argc)
+            target_frame_ms = atof(argv[++i]);
+        else if (strcmp(argv[i], "--views") == 0 && i + 1 < argc)
+            options.views = (size_t)std::clamp(atoi(argv[++i]), 1, (int)MAX_VIEWS);
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            options.record_path = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            options.replay_path = argv[++i];
+    }
+
     Renderer renderer(WINDOW_WIDTH, WINDOW_HEIGHT, "Hello Metal");
-    Application app;
+    renderer.set_target_frame_ms(target_frame_ms);
+    renderer.set_view_count(options.views);
+    Application app(options);
 
     return app.run(&renderer);
 }
@@ -0,0 +1,159 @@
+#include "mesh.h"
+
+#include <cstring>
+
+const uint32_t MAX_U16_VERTICES = 0x10000;
+const uint32_t NO_REMAP = 0xffffffff;
+
+size_t index_size(IndexWidth width)
+{
+    return width == IndexWidth::U16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+static size_t align4(size_t size)
+{
+    return (size + 3) & ~(size_t)3;
+}
+
+static void append_chunk(PackedMesh& packed, uint32_t vertex_offset, uint32_t vertex_count,
+                         const uint32_t* indices, size_t count, IndexWidth width)
+{
+    // keep every chunk 4 bytes aligned for indexBufferOffset
+    size_t offset = align4(packed.index_data.size());
+    packed.index_data.resize(offset + count * index_size(width));
+
+    uint8_t* dst = packed.index_data.data() + offset;
+
+    if (width == IndexWidth::U16) {
+        for (size_t i = 0; i < count; i++) {
+            uint16_t idx = (uint16_t)indices[i];
+            memcpy(dst + i * sizeof(uint16_t), &idx, sizeof(uint16_t));
+        }
+    }
+    else {
+        memcpy(dst, indices, count * sizeof(uint32_t));
+    }
+
+    packed.chunks.push_back({ vertex_offset, vertex_count, (uint32_t)offset, (uint32_t)count, width });
+}
+
+static void append_packed(PackedMesh& dst, const PackedMesh& src)
+{
+    uint32_t vertex_base = (uint32_t)dst.vertices.size();
+    size_t index_base = align4(dst.index_data.size());
+
+    dst.vertices.insert(dst.vertices.end(), src.vertices.begin(), src.vertices.end());
+    dst.index_data.resize(index_base);
+    dst.index_data.insert(dst.index_data.end(), src.index_data.begin(), src.index_data.end());
+
+    for (MeshChunk chunk : src.chunks) {
+        chunk.vertex_offset += vertex_base;
+        chunk.index_offset += (uint32_t)index_base;
+        dst.chunks.push_back(chunk);
+    }
+}
+
+static PackedMesh split_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+    PackedMesh packed;
+
+    std::vector<uint32_t> remap(vertices.size(), NO_REMAP);
+    std::vector<uint32_t> chunk_vertices;
+    std::vector<uint32_t> chunk_indices;
+
+    auto flush = [&]() {
+        if (chunk_indices.empty())
+            return;
+
+        uint32_t vertex_offset = (uint32_t)packed.vertices.size();
+        for (uint32_t v : chunk_vertices) {
+            packed.vertices.push_back(vertices[v]);
+            remap[v] = NO_REMAP;
+        }
+
+        append_chunk(packed, vertex_offset, (uint32_t)chunk_vertices.size(),
+                     chunk_indices.data(), chunk_indices.size(), IndexWidth::U16);
+
+        chunk_vertices.clear();
+        chunk_indices.clear();
+    };
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const uint32_t* tri = &indices[i];
+
+        uint32_t new_vertices = 0;
+        for (int k = 0; k < 3; k++)
+            new_vertices += remap[tri[k]] == NO_REMAP;
+
+        if (chunk_vertices.size() + new_vertices > MAX_U16_VERTICES)
+            flush();
+
+        for (int k = 0; k < 3; k++) {
+            if (remap[tri[k]] == NO_REMAP) {
+                remap[tri[k]] = (uint32_t)chunk_vertices.size();
+                chunk_vertices.push_back(tri[k]);
+            }
+
+            chunk_indices.push_back(remap[tri[k]]);
+        }
+    }
+
+    flush();
+
+    return packed;
+}
+
+PackedMesh pack_mesh(const Mesh& mesh)
+{
+    return pack_mesh(mesh.vertices, {{ mesh.indices, 0.0f }});
+}
+
+PackedMesh pack_mesh(const std::vector<Vertex>& vertices, const std::vector<MeshLod>& lods)
+{
+    PackedMesh packed;
+
+    uint32_t vertex_count = (uint32_t)vertices.size();
+    // offset of the unsplit vertex copy, shared by all lods drawn whole
+    uint32_t shared_offset = NO_REMAP;
+
+    if (vertex_count <= MAX_U16_VERTICES) {
+        packed.vertices = vertices;
+        shared_offset = 0;
+    }
+
+    for (const MeshLod& lod : lods) {
+        PackedLod packed_lod = { (uint32_t)packed.chunks.size(), 0, (uint32_t)(lod.indices.size() / 3), lod.error };
+
+        bool split = false;
+
+        if (vertex_count > MAX_U16_VERTICES) {
+            PackedMesh chunks = split_mesh(vertices, lod.indices);
+
+            size_t split_bytes = chunks.vertices.size() * sizeof(Vertex) + chunks.index_data.size();
+            size_t whole_bytes = lod.indices.size() * sizeof(uint32_t);
+
+            if (shared_offset == NO_REMAP)
+                whole_bytes += vertices.size() * sizeof(Vertex);
+
+            if (split_bytes < whole_bytes) {
+                append_packed(packed, chunks);
+                split = true;
+            }
+        }
+
+        if (!split) {
+            if (shared_offset == NO_REMAP) {
+                shared_offset = (uint32_t)packed.vertices.size();
+                packed.vertices.insert(packed.vertices.end(), vertices.begin(), vertices.end());
+            }
+
+            IndexWidth width = vertex_count > MAX_U16_VERTICES ? IndexWidth::U32 : IndexWidth::U16;
+            append_chunk(packed, shared_offset, vertex_count, lod.indices.data(), lod.indices.size(), width);
+        }
+
+        packed_lod.chunk_count = (uint32_t)packed.chunks.size() - packed_lod.first_chunk;
+        packed.lods.push_back(packed_lod);
+    }
+
+    return packed;
+}
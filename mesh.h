@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+typedef float vec3[3];
+
+struct Vertex {
+    vec3 position; // attributes 0
+    vec3 color;    // attributes 1
+};
+
+enum class IndexWidth {
+    U16,
+    U32,
+};
+
+// a contiguous run of indices sharing the same width, drawn with
+// vertex_offset as base vertex
+struct MeshChunk {
+    uint32_t vertex_offset;
+    uint32_t vertex_count;
+    uint32_t index_offset; // in bytes
+    uint32_t index_count;
+    IndexWidth index_width;
+};
+
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// index only level of detail sharing the mesh vertices, error is the
+// object space deviation from the full mesh
+struct MeshLod {
+    std::vector<uint32_t> indices;
+    float error;
+};
+
+struct PackedLod {
+    uint32_t first_chunk;
+    uint32_t chunk_count;
+    uint32_t triangle_count;
+    float error;
+};
+
+// GPU ready mesh: indices are stored at the narrowest width possible
+struct PackedMesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint8_t> index_data;
+    std::vector<MeshChunk> chunks;
+    std::vector<PackedLod> lods;
+};
+
+size_t index_size(IndexWidth width);
+
+// picks 16 bit indices when the mesh fits, otherwise splits it into
+// chunks of at most 65536 vertices if that costs less memory than
+// keeping 32 bit indices
+PackedMesh pack_mesh(const Mesh& mesh);
+PackedMesh pack_mesh(const std::vector<Vertex>& vertices, const std::vector<MeshLod>& lods);
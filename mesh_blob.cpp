@@ -0,0 +1,128 @@
+#include "mesh_blob.h"
+
+#include <cstring>
+
+const uint32_t MESH_BLOB_MAGIC = 0x4853454d; // "MESH"
+const uint32_t MESH_BLOB_VERSION = 1;
+
+enum {
+    SECTION_VERTICES = 0,
+    SECTION_INDEX_DATA,
+    SECTION_CHUNKS,
+    SECTION_LODS,
+    SECTION_MESHLETS,
+    SECTION_MESHLET_INDICES,
+    SECTION_CHUNK_MESHLETS,
+    SECTION_COUNT,
+};
+
+struct MeshBlobSection {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct MeshBlobHeader {
+    uint32_t magic;
+    uint32_t version;
+    MeshBlobSection sections[SECTION_COUNT];
+};
+
+template <typename T>
+static void write_section(std::vector<uint8_t>& out, MeshBlobHeader& header, int section, const std::vector<T>& v)
+{
+    size_t offset = (out.size() + 15) & ~(size_t)15;
+    out.resize(offset + v.size() * sizeof(T));
+
+    if (!v.empty())
+        memcpy(out.data() + offset, v.data(), v.size() * sizeof(T));
+
+    header.sections[section] = { offset, v.size() };
+}
+
+template <typename T>
+static bool view_section(const uint8_t* data, size_t size, const MeshBlobHeader& header, int section, BlobArray<T>& v)
+{
+    const MeshBlobSection& s = header.sections[section];
+
+    if (s.offset > size || s.count > (size - s.offset) / sizeof(T))
+        return false;
+
+    v = { (const T*)(data + s.offset), (size_t)s.count };
+
+    return true;
+}
+
+std::vector<uint8_t> write_mesh_blob(const ProcessedMesh& mesh)
+{
+    MeshBlobHeader header = {};
+    header.magic = MESH_BLOB_MAGIC;
+    header.version = MESH_BLOB_VERSION;
+
+    std::vector<uint8_t> out(sizeof(header));
+
+    write_section(out, header, SECTION_VERTICES, mesh.packed.vertices);
+    write_section(out, header, SECTION_INDEX_DATA, mesh.packed.index_data);
+    write_section(out, header, SECTION_CHUNKS, mesh.packed.chunks);
+    write_section(out, header, SECTION_LODS, mesh.packed.lods);
+    write_section(out, header, SECTION_MESHLETS, mesh.meshlets.meshlets);
+    write_section(out, header, SECTION_MESHLET_INDICES, mesh.meshlets.indices);
+    write_section(out, header, SECTION_CHUNK_MESHLETS, mesh.meshlets.chunk_meshlets);
+
+    memcpy(out.data(), &header, sizeof(header));
+
+    return out;
+}
+
+template <typename T>
+static void copy_section(const BlobArray<T>& a, std::vector<T>& v)
+{
+    v.resize(a.count);
+
+    if (a.count > 0)
+        memcpy(v.data(), a.data, a.count * sizeof(T));
+}
+
+// sections may be unaligned here, only view_mesh_blob hands them out
+static bool parse_mesh_blob(const uint8_t* data, size_t size, MeshBlobView& view)
+{
+    MeshBlobHeader header;
+
+    if (size < sizeof(header))
+        return false;
+
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != MESH_BLOB_MAGIC || header.version != MESH_BLOB_VERSION)
+        return false;
+
+    return view_section(data, size, header, SECTION_VERTICES, view.vertices)
+        && view_section(data, size, header, SECTION_INDEX_DATA, view.index_data)
+        && view_section(data, size, header, SECTION_CHUNKS, view.chunks)
+        && view_section(data, size, header, SECTION_LODS, view.lods)
+        && view_section(data, size, header, SECTION_MESHLETS, view.meshlets)
+        && view_section(data, size, header, SECTION_MESHLET_INDICES, view.meshlet_indices)
+        && view_section(data, size, header, SECTION_CHUNK_MESHLETS, view.chunk_meshlets);
+}
+
+bool view_mesh_blob(const uint8_t* data, size_t size, MeshBlobView& view)
+{
+    return (uintptr_t)data % 16 == 0 && parse_mesh_blob(data, size, view);
+}
+
+bool read_mesh_blob(const uint8_t* data, size_t size, ProcessedMesh& mesh)
+{
+    MeshBlobView view;
+
+    if (!parse_mesh_blob(data, size, view))
+        return false;
+
+    copy_section(view.vertices, mesh.packed.vertices);
+    copy_section(view.index_data, mesh.packed.index_data);
+    copy_section(view.chunks, mesh.packed.chunks);
+    copy_section(view.lods, mesh.packed.lods);
+    copy_section(view.meshlets, mesh.meshlets.meshlets);
+    copy_section(view.meshlet_indices, mesh.meshlets.indices);
+    copy_section(view.chunk_meshlets, mesh.meshlets.chunk_meshlets);
+
+    return true;
+}
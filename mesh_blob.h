@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+#include "meshlet.h"
+
+// everything init_resources derives from a source mesh
+struct ProcessedMesh {
+    PackedMesh packed;
+    MeshletMesh meshlets;
+};
+
+// array inside a blob, valid as long as the blob's memory is
+template <typename T>
+struct BlobArray {
+    const T* data;
+    size_t count;
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + count; }
+    size_t size() const { return count; }
+    const T& operator[](size_t i) const { return data[i]; }
+};
+
+// the arrays of a ProcessedMesh, pointing into a blob
+struct MeshBlobView {
+    BlobArray<Vertex> vertices;
+    BlobArray<uint8_t> index_data;
+    BlobArray<MeshChunk> chunks;
+    BlobArray<PackedLod> lods;
+    BlobArray<Meshlet> meshlets;
+    BlobArray<uint32_t> meshlet_indices;
+    BlobArray<uint32_t> chunk_meshlets;
+};
+
+// Flat little endian blob: a header of section offsets and counts, then
+// each array 16 bytes aligned. view_mesh_blob reads it in place and
+// fails unless the blob itself is 16 bytes aligned, as mapped files and
+// cache payloads are. read_mesh_blob copies it out from anywhere.
+std::vector<uint8_t> write_mesh_blob(const ProcessedMesh& mesh);
+bool view_mesh_blob(const uint8_t* data, size_t size, MeshBlobView& view);
+bool read_mesh_blob(const uint8_t* data, size_t size, ProcessedMesh& mesh);
@@ -0,0 +1,337 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+static uint32_t read_index(const PackedMesh& packed, const MeshChunk& chunk, size_t i)
+{
+    const uint8_t* src = packed.index_data.data() + chunk.index_offset;
+
+    if (chunk.index_width == IndexWidth::U16) {
+        uint16_t idx;
+        memcpy(&idx, src + i * sizeof(uint16_t), sizeof(idx));
+        return idx;
+    }
+
+    uint32_t idx;
+    memcpy(&idx, src + i * sizeof(uint32_t), sizeof(idx));
+    return idx;
+}
+
+static float length(const float* v)
+{
+    return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+static float dot(const float* a, const float* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// clockwise front facing normal
+static void front_normal(const float* p0, const float* p1, const float* p2, float* n)
+{
+    float e0[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+
+    n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+static void compute_bounds(const Vertex* vertices, const uint32_t* indices, Meshlet& m)
+{
+    size_t count = m.triangle_count * 3;
+
+    float lo[3], hi[3];
+    for (int k = 0; k < 3; k++)
+        lo[k] = hi[k] = vertices[indices[0]].position[k];
+
+    for (size_t i = 0; i < count; i++) {
+        for (int k = 0; k < 3; k++) {
+            lo[k] = std::min(lo[k], vertices[indices[i]].position[k]);
+            hi[k] = std::max(hi[k], vertices[indices[i]].position[k]);
+        }
+    }
+
+    for (int k = 0; k < 3; k++)
+        m.center[k] = (lo[k] + hi[k]) * 0.5f;
+
+    m.radius = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        const float* p = vertices[indices[i]].position;
+        float d[3] = { p[0] - m.center[0], p[1] - m.center[1], p[2] - m.center[2] };
+        m.radius = std::max(m.radius, length(d));
+    }
+
+    // normal cone around the average triangle normal
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    std::vector<float> normals(m.triangle_count * 3);
+
+    for (uint32_t t = 0; t < m.triangle_count; t++) {
+        float* n = &normals[t * 3];
+        front_normal(vertices[indices[t * 3]].position, vertices[indices[t * 3 + 1]].position,
+                     vertices[indices[t * 3 + 2]].position, n);
+
+        float len = length(n);
+        for (int k = 0; k < 3; k++) {
+            n[k] = len > 0.0f ? n[k] / len : 0.0f;
+            axis[k] += n[k];
+        }
+    }
+
+    float axis_len = length(axis);
+    for (int k = 0; k < 3; k++) {
+        m.cone_axis[k] = axis_len > 0.0f ? axis[k] / axis_len : 0.0f;
+        m.cone_apex[k] = m.center[k];
+    }
+
+    float min_dp = 1.0f;
+    for (uint32_t t = 0; t < m.triangle_count; t++)
+        min_dp = std::min(min_dp, dot(&normals[t * 3], m.cone_axis));
+
+    if (axis_len == 0.0f || min_dp <= 0.0f) {
+        m.cone_cutoff = 2.0f;
+        return;
+    }
+
+    // move the apex back so the cone contains every triangle plane
+    float max_t = 0.0f;
+    for (uint32_t t = 0; t < m.triangle_count; t++) {
+        const float* p0 = vertices[indices[t * 3]].position;
+        const float* n = &normals[t * 3];
+
+        float dc[3] = { m.center[0] - p0[0], m.center[1] - p0[1], m.center[2] - p0[2] };
+        float dn = dot(m.cone_axis, n);
+
+        if (dn > 0.0f)
+            max_t = std::max(max_t, dot(dc, n) / dn);
+    }
+
+    for (int k = 0; k < 3; k++)
+        m.cone_apex[k] = m.center[k] - m.cone_axis[k] * max_t;
+
+    m.cone_cutoff = std::sqrt(1.0f - min_dp * min_dp);
+}
+
+MeshletMesh build_meshlets(const PackedMesh& packed, size_t max_vertices, size_t max_triangles)
+{
+    MeshletMesh out;
+    std::vector<uint32_t> meshlet_vertices;
+
+    for (const MeshChunk& chunk : packed.chunks) {
+        out.chunk_meshlets.push_back((uint32_t)out.meshlets.size());
+
+        const Vertex* vertices = packed.vertices.data() + chunk.vertex_offset;
+        Meshlet current = {};
+        current.index_offset = (uint32_t)out.indices.size();
+        meshlet_vertices.clear();
+
+        auto flush = [&]() {
+            if (current.triangle_count == 0)
+                return;
+
+            current.vertex_count = (uint32_t)meshlet_vertices.size();
+            compute_bounds(vertices, &out.indices[current.index_offset], current);
+            out.meshlets.push_back(current);
+
+            current = {};
+            current.index_offset = (uint32_t)out.indices.size();
+            meshlet_vertices.clear();
+        };
+
+        for (size_t i = 0; i + 2 < chunk.index_count; i += 3) {
+            uint32_t tri[3];
+            size_t new_vertices = 0;
+
+            for (int k = 0; k < 3; k++) {
+                tri[k] = read_index(packed, chunk, i + k);
+                bool seen = std::find(meshlet_vertices.begin(), meshlet_vertices.end(), tri[k]) != meshlet_vertices.end();
+                new_vertices += !seen && (k == 0 || tri[k] != tri[0]) && (k < 2 || tri[k] != tri[1]);
+            }
+
+            if (meshlet_vertices.size() + new_vertices > max_vertices || current.triangle_count == max_triangles)
+                flush();
+
+            for (int k = 0; k < 3; k++) {
+                if (std::find(meshlet_vertices.begin(), meshlet_vertices.end(), tri[k]) == meshlet_vertices.end())
+                    meshlet_vertices.push_back(tri[k]);
+
+                out.indices.push_back(tri[k]);
+            }
+
+            current.triangle_count++;
+        }
+
+        flush();
+    }
+
+    out.chunk_meshlets.push_back((uint32_t)out.meshlets.size());
+
+    return out;
+}
+
+void frustum_planes(const float* mvp, float planes[6][4])
+{
+    // rows of the column major matrix
+    float r[4][4];
+    for (int i = 0; i < 4; i++)
+        for (int c = 0; c < 4; c++)
+            r[i][c] = mvp[c * 4 + i];
+
+    for (int c = 0; c < 4; c++) {
+        planes[0][c] = r[3][c] + r[0][c]; // left
+        planes[1][c] = r[3][c] - r[0][c]; // right
+        planes[2][c] = r[3][c] + r[1][c]; // bottom
+        planes[3][c] = r[3][c] - r[1][c]; // top
+        planes[4][c] = r[2][c];           // near, depth is zero to one
+        planes[5][c] = r[3][c] - r[2][c]; // far
+    }
+
+    for (int p = 0; p < 6; p++) {
+        float len = length(planes[p]);
+        if (len > 0.0f)
+            for (int c = 0; c < 4; c++)
+                planes[p][c] /= len;
+    }
+}
+
+static bool meshlet_visible(const Meshlet& m, const CullView& v)
+{
+    for (int p = 0; p < 6; p++) {
+        if (dot(v.planes[p], m.center) + v.planes[p][3] < -m.radius)
+            return false;
+    }
+
+    const float* eye = v.camera_position;
+    float view[3] = { m.cone_apex[0] - eye[0], m.cone_apex[1] - eye[1], m.cone_apex[2] - eye[2] };
+    float len = length(view);
+
+    return len == 0.0f || dot(view, m.cone_axis) < m.cone_cutoff * len;
+}
+
+static bool meshlet_visible(const Meshlet& m, const CullView* views, size_t view_count)
+{
+    for (size_t i = 0; i < view_count; i++) {
+        if (meshlet_visible(m, views[i]))
+            return true;
+    }
+
+    return false;
+}
+
+void cull_meshlets(const std::vector<MeshChunk>& source_chunks, const MeshletMesh& meshlets,
+                   uint32_t first_chunk, uint32_t chunk_count,
+                   const CullView* views, size_t view_count,
+                   std::vector<uint8_t>& index_data, std::vector<MeshChunk>& chunks,
+                   MeshletCullStats& stats)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    stats = {};
+
+    for (uint32_t c = first_chunk; c < first_chunk + chunk_count; c++) {
+        MeshChunk chunk = source_chunks[c];
+
+        chunk.index_offset = (uint32_t)((index_data.size() + 3) & ~(size_t)3);
+        chunk.index_count = 0;
+
+        size_t width = index_size(chunk.index_width);
+        index_data.resize(chunk.index_offset);
+
+        for (uint32_t i = meshlets.chunk_meshlets[c]; i < meshlets.chunk_meshlets[c + 1]; i++) {
+            const Meshlet& m = meshlets.meshlets[i];
+
+            stats.meshlets++;
+            stats.triangles += m.triangle_count;
+
+            if (!meshlet_visible(m, views, view_count)) {
+                stats.meshlets_culled++;
+                stats.triangles_culled += m.triangle_count;
+                continue;
+            }
+
+            size_t count = m.triangle_count * 3;
+            const uint32_t* src = &meshlets.indices[m.index_offset];
+
+            size_t offset = index_data.size();
+            index_data.resize(offset + count * width);
+
+            if (chunk.index_width == IndexWidth::U16) {
+                for (size_t k = 0; k < count; k++) {
+                    uint16_t idx = (uint16_t)src[k];
+                    memcpy(&index_data[offset + k * sizeof(uint16_t)], &idx, sizeof(idx));
+                }
+            }
+            else {
+                memcpy(&index_data[offset], src, count * sizeof(uint32_t));
+            }
+
+            chunk.index_count += (uint32_t)count;
+        }
+
+        if (chunk.index_count > 0)
+            chunks.push_back(chunk);
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    stats.cull_ms = elapsed.count();
+}
+
+void cull_meshlets(const std::vector<MeshChunk>& source_chunks, const MeshletMesh& meshlets,
+                   uint32_t first_chunk, uint32_t chunk_count,
+                   const CullView* views, size_t view_count,
+                   std::vector<uint8_t>& index_data, std::vector<MeshChunk>& chunks,
+                   MeshletCullStats& stats, JobSystem& jobs)
+{
+    if (chunk_count <= 1 || jobs.thread_count() <= 1) {
+        cull_meshlets(source_chunks, meshlets, first_chunk, chunk_count,
+                      views, view_count, index_data, chunks, stats);
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    struct ChunkOutput {
+        std::vector<uint8_t> index_data;
+        std::vector<MeshChunk> chunks;
+        MeshletCullStats stats;
+    };
+
+    std::vector<ChunkOutput> outputs(chunk_count);
+
+    jobs.parallel_for(chunk_count, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            ChunkOutput& out = outputs[i];
+            cull_meshlets(source_chunks, meshlets, first_chunk + (uint32_t)i, 1,
+                          views, view_count, out.index_data, out.chunks, out.stats);
+        }
+    });
+
+    stats = {};
+
+    for (const ChunkOutput& out : outputs) {
+        stats.meshlets += out.stats.meshlets;
+        stats.meshlets_culled += out.stats.meshlets_culled;
+        stats.triangles += out.stats.triangles;
+        stats.triangles_culled += out.stats.triangles_culled;
+
+        if (out.chunks.empty())
+            continue;
+
+        // local offsets start at zero, rebase onto the aligned end
+        size_t base = (index_data.size() + 3) & ~(size_t)3;
+        index_data.resize(base);
+        index_data.insert(index_data.end(), out.index_data.begin(), out.index_data.end());
+
+        for (MeshChunk chunk : out.chunks) {
+            chunk.index_offset += (uint32_t)base;
+            chunks.push_back(chunk);
+        }
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    stats.cull_ms = elapsed.count();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "job_system.h"
+#include "mesh.h"
+
+// Small triangle cluster with its bounding sphere and normal cone. Front
+// faces are clockwise, as with the Metal default winding.
+struct Meshlet {
+    float center[3];
+    float radius;
+    float cone_apex[3];
+    float cone_cutoff; // > 1 when the cone can never be back facing
+    float cone_axis[3];
+    uint32_t index_offset; // into MeshletMesh::indices
+    uint32_t triangle_count;
+    uint32_t vertex_count;
+};
+
+// meshlets are built per packed chunk, indices stay local to the chunk
+// so culled output can be drawn with the chunk's width and base vertex
+struct MeshletMesh {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> chunk_meshlets; // first meshlet per chunk, chunks + 1 entries
+};
+
+struct MeshletCullStats {
+    uint32_t meshlets;
+    uint32_t meshlets_culled;
+    uint32_t triangles;
+    uint32_t triangles_culled;
+    double cull_ms;
+};
+
+MeshletMesh build_meshlets(const PackedMesh& packed, size_t max_vertices, size_t max_triangles);
+
+// frustum and camera position of one view, in object space
+struct CullView {
+    float planes[6][4];
+    float camera_position[3];
+};
+
+// object space planes of a column major, zero to one depth mvp
+void frustum_planes(const float* mvp, float planes[6][4]);
+
+// culls the meshlets of chunks [first_chunk, first_chunk + chunk_count)
+// against the views, keeping those any view can see, and appends the
+// surviving triangles to index_data with one chunk per source chunk
+void cull_meshlets(const std::vector<MeshChunk>& source_chunks, const MeshletMesh& meshlets,
+                   uint32_t first_chunk, uint32_t chunk_count,
+                   const CullView* views, size_t view_count,
+                   std::vector<uint8_t>& index_data, std::vector<MeshChunk>& chunks,
+                   MeshletCullStats& stats);
+
+// same as above with chunks culled in parallel, draws the same triangles
+void cull_meshlets(const std::vector<MeshChunk>& source_chunks, const MeshletMesh& meshlets,
+                   uint32_t first_chunk, uint32_t chunk_count,
+                   const CullView* views, size_t view_count,
+                   std::vector<uint8_t>& index_data, std::vector<MeshChunk>& chunks,
+                   MeshletCullStats& stats, JobSystem& jobs);
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "mesh.h"
+#include "meshlet.h"
+#include "vertex_format.h"
+
+// views rendered per second
+struct MultiviewThroughput {
+    double shared;   // all views in one pass
+    double separate; // a pass per view
+};
+
+// CPU stand in for the vertex stage of a multi view pass: one vertex per
+// index of the culled chunks, like the vertex shader without its cache.
+// Each vertex is fetched and decoded once and transformed by all of the
+// column major mvps, the sum of the clip w goes to sink.
+template <typename Layout>
+void transform_views(const QuantizedVertices& vertices, const std::vector<uint8_t>& index_data,
+                     const std::vector<MeshChunk>& chunks, const float* mvps, size_t view_count, float& sink)
+{
+    Vertex v;
+
+    for (const MeshChunk& chunk : chunks) {
+        const uint8_t* indices = index_data.data() + chunk.index_offset;
+
+        for (uint32_t i = 0; i < chunk.index_count; i++) {
+            uint32_t index;
+            if (chunk.index_width == IndexWidth::U16) {
+                uint16_t s;
+                memcpy(&s, indices + i * sizeof(uint16_t), sizeof(s));
+                index = s;
+            }
+            else {
+                memcpy(&index, indices + i * sizeof(uint32_t), sizeof(index));
+            }
+
+            Layout::fetch(vertices.data.data(), chunk.vertex_offset + index, vertices.transform, v);
+
+            for (size_t view = 0; view < view_count; view++) {
+                const float* m = mvps + view * 16;
+                sink += m[3] * v.position[0] + m[7] * v.position[1] + m[11] * v.position[2] + m[15];
+                for (int r = 0; r < 3; r++)
+                    sink += m[r] * v.position[0] + m[4 + r] * v.position[1] + m[8 + r] * v.position[2] + m[12 + r];
+            }
+        }
+    }
+}
+
+// culling and vertex work for view_count views of the chunks [first_chunk,
+// first_chunk + chunk_count), culled once for all views and transformed
+// with one fetch per vertex against culled and transformed view by view
+template <typename Layout>
+MultiviewThroughput measure_multiview(const std::vector<MeshChunk>& source_chunks, const MeshletMesh& meshlets,
+                                      uint32_t first_chunk, uint32_t chunk_count,
+                                      const QuantizedVertices& vertices, const CullView* views,
+                                      const float* mvps, size_t view_count, int iterations)
+{
+    std::vector<uint8_t> index_data;
+    std::vector<MeshChunk> chunks;
+    MeshletCullStats stats;
+    float sink = 0.0f;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++) {
+        index_data.clear();
+        chunks.clear();
+        cull_meshlets(source_chunks, meshlets, first_chunk, chunk_count, views, view_count, index_data, chunks, stats);
+        transform_views<Layout>(vertices, index_data, chunks, mvps, view_count, sink);
+    }
+    std::chrono::duration<double> shared = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (size_t view = 0; view < view_count; view++) {
+            index_data.clear();
+            chunks.clear();
+            cull_meshlets(source_chunks, meshlets, first_chunk, chunk_count, views + view, 1, index_data, chunks, stats);
+            transform_views<Layout>(vertices, index_data, chunks, mvps + view * 16, 1, sink);
+        }
+    }
+    std::chrono::duration<double> separate = std::chrono::steady_clock::now() - start;
+
+    volatile float keep = sink;
+    (void)keep;
+
+    double frames = (double)iterations * view_count;
+
+    return {
+        shared.count() > 0 ? frames / shared.count() : 0,
+        separate.count() > 0 ? frames / separate.count() : 0,
+    };
+}
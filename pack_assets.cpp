@@ -0,0 +1,30 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "mesh_blob.h"
+#include "scene.h"
+
+// Writes the processed scene mesh to the given path, the blob that
+// make EMBED=1 links into the executable next to shader.metallib.
+int main(int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "usage: pack_assets <output>\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> blob = write_mesh_blob(process_mesh(scene_mesh()));
+
+    std::ofstream file(argv[1], std::ios::binary);
+    file.write((const char*)blob.data(), (std::streamsize)blob.size());
+
+    if (!file) {
+        std::cerr << "Failed to write " << argv[1] << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+#include "pipeline_manager.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#include <objc/message.h>
+
+#include "asset_cache.h"
+
+#define NSSTRING(s) (NS::String::string((s), NS::ASCIIStringEncoding))
+
+static MTL::VertexFormat mtl_vertex_format(VertexFormat format)
+{
+    switch (format) {
+    case VertexFormat::Float3:
+        return MTL::VertexFormatFloat3;
+    case VertexFormat::Half4:
+        return MTL::VertexFormatHalf4;
+    case VertexFormat::Short4Normalized:
+        return MTL::VertexFormatShort4Normalized;
+    case VertexFormat::UChar4Normalized:
+        return MTL::VertexFormatUChar4Normalized;
+    }
+
+    return MTL::VertexFormatInvalid;
+}
+
+static MTL::VertexDescriptor* mtl_vertex_descriptor(const VertexLayout& layout)
+{
+    MTL::VertexDescriptor* vert_desc = MTL::VertexDescriptor::vertexDescriptor();
+    const VertexAttribute* attributes[] = { &layout.position, &layout.color };
+
+    for (NS::UInteger i = 0; i < 2; i++) {
+        vert_desc->attributes()->object(i)->setFormat(mtl_vertex_format(attributes[i]->format));
+        vert_desc->attributes()->object(i)->setOffset(attributes[i]->offset);
+        vert_desc->attributes()->object(i)->setBufferIndex(0);
+    }
+
+    vert_desc->layouts()->object(0)->setStepFunction(MTL::VertexStepFunctionPerVertex);
+    vert_desc->layouts()->object(0)->setStride(layout.stride);
+
+    return vert_desc;
+}
+
+// the bundled metal-cpp only exposes binaryArchives on compute descriptors
+static void set_binary_archives(MTL::RenderPipelineDescriptor* descriptor, MTL::BinaryArchive* archive)
+{
+    NS::Array* archives = NS::Array::array(archive);
+
+    ((void (*)(void*, SEL, NS::Array*))objc_msgSend)(descriptor, sel_registerName("setBinaryArchives:"), archives);
+}
+
+uint64_t hash_pipeline_desc(const PipelineDesc& desc)
+{
+    uint64_t h = hash_bytes(desc.vertex_function.data(), desc.vertex_function.size(), 0);
+    h = hash_bytes(desc.fragment_function.data(), desc.fragment_function.size(), h);
+
+    const uint32_t state[] = {
+        (uint32_t)desc.color_format,
+        (uint32_t)desc.vertex_layout.position.format, desc.vertex_layout.position.offset,
+        (uint32_t)desc.vertex_layout.color.format, desc.vertex_layout.color.offset,
+        desc.vertex_layout.stride,
+        desc.max_amplification,
+    };
+
+    return hash_bytes(state, sizeof(state), h);
+}
+
+PipelineManager::PipelineManager()
+    : device(nullptr)
+    , library(nullptr)
+    , archive(nullptr)
+    , archive_loaded(false)
+    , pending_count(0)
+    , miss_count(0)
+{
+}
+
+void PipelineManager::init(MTL::Device* d, MTL::Library* l, const std::string& path)
+{
+    NS::Error* error = nullptr;
+
+    device = d;
+    library = l;
+    archive_path = path;
+
+    std::error_code ec;
+    bool exists = std::filesystem::exists(archive_path, ec);
+
+    MTL::BinaryArchiveDescriptor* archive_desc = MTL::BinaryArchiveDescriptor::alloc()->init();
+
+    if (exists) {
+        archive_desc->setUrl(NS::URL::fileURLWithPath(NSSTRING(archive_path.c_str())));
+        archive = device->newBinaryArchive(archive_desc, &error);
+        archive_loaded = archive != nullptr;
+
+        if (!archive)
+            std::cerr << "Failed to load pipeline archive, rebuilding it\n";
+    }
+
+    if (!archive) {
+        archive_desc->setUrl(nullptr);
+        archive = device->newBinaryArchive(archive_desc, &error);
+    }
+
+    archive_desc->release();
+}
+
+void PipelineManager::cleanup()
+{
+    wait_all();
+
+    // the loaded archive maps the old file, so write next to it and
+    // replace it
+    if (archive && miss_count.load() > 0) {
+        NS::Error* error = nullptr;
+        std::string temp_path = archive_path + ".tmp";
+        std::error_code ec;
+
+        if (archive->serializeToURL(NS::URL::fileURLWithPath(NSSTRING(temp_path.c_str())), &error)) {
+            std::filesystem::rename(temp_path, archive_path, ec);
+
+            if (ec)
+                std::cerr << "Failed to replace pipeline archive: " << ec.message() << "\n";
+        }
+        else {
+            std::cerr << "Failed to write pipeline archive\n";
+        }
+    }
+
+    for (Slot& slot : slots) {
+        if (slot.state)
+            slot.state->release();
+    }
+
+    slots.clear();
+    handles.clear();
+
+    if (archive)
+        archive->release();
+
+    archive = nullptr;
+}
+
+PipelineHandle PipelineManager::request(const PipelineDesc& desc)
+{
+    uint64_t hash = hash_pipeline_desc(desc);
+
+    auto it = handles.find(hash);
+    if (it != handles.end())
+        return it->second;
+
+    PipelineHandle handle = (PipelineHandle)slots.size();
+    handles[hash] = handle;
+
+    slots.emplace_back();
+    Slot* slot = &slots.back();
+    slot->hash = hash;
+    slot->state = nullptr;
+    slot->status.store(PipelineStatus::Pending);
+
+    MTL::Function* vert_fun = library->newFunction(NSSTRING(desc.vertex_function.c_str()));
+    MTL::Function* frag_fun = library->newFunction(NSSTRING(desc.fragment_function.c_str()));
+
+    if (!vert_fun) {
+        std::cerr << "Failed to load " << desc.vertex_function << " function from library\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (!frag_fun) {
+        std::cerr << "Failed to load " << desc.fragment_function << " function from library\n";
+        exit(EXIT_FAILURE);
+    }
+
+    MTL::RenderPipelineDescriptor* descriptor = MTL::RenderPipelineDescriptor::alloc()->init();
+    descriptor->setLabel(NSSTRING(desc.vertex_function.c_str()));
+    descriptor->setVertexFunction(vert_fun);
+    descriptor->setFragmentFunction(frag_fun);
+    descriptor->colorAttachments()->object(0)->setPixelFormat(desc.color_format);
+    descriptor->setVertexDescriptor(mtl_vertex_descriptor(desc.vertex_layout));
+
+    if (desc.max_amplification > 1)
+        descriptor->setMaxVertexAmplificationCount(desc.max_amplification);
+
+    if (archive_loaded)
+        set_binary_archives(descriptor, archive);
+
+    vert_fun->release();
+    frag_fun->release();
+
+    pending_count++;
+    compile(slot, descriptor, archive_loaded);
+
+    return handle;
+}
+
+void PipelineManager::compile(Slot* slot, MTL::RenderPipelineDescriptor* descriptor, bool from_archive)
+{
+    MTL::PipelineOption options = from_archive ? MTL::PipelineOptionFailOnBinaryArchiveMiss : MTL::PipelineOptionNone;
+
+    device->newRenderPipelineState(descriptor, options, [this, slot, descriptor, from_archive](MTL::RenderPipelineState* state, MTL::RenderPipelineReflection*, NS::Error* error) {
+        if (!state && from_archive) {
+            compile(slot, descriptor, false);
+            return;
+        }
+
+        if (state) {
+            state->retain();
+
+            if (!from_archive) {
+                NS::Error* archive_error = nullptr;
+                if (archive && !archive->addRenderPipelineFunctions(descriptor, &archive_error))
+                    std::cerr << "Failed to add pipeline to archive\n";
+
+                miss_count++;
+            }
+        }
+        else {
+            std::cerr << "Failed to create pipeline state: "
+                      << (error ? error->localizedDescription()->utf8String() : "unknown error") << "\n";
+        }
+
+        slot->state = state;
+        slot->status.store(state ? PipelineStatus::Ready : PipelineStatus::Failed, std::memory_order_release);
+
+        descriptor->release();
+        pending_count--;
+    });
+}
+
+MTL::RenderPipelineState* PipelineManager::get(PipelineHandle handle) const
+{
+    return status(handle) == PipelineStatus::Ready ? slots[handle].state : nullptr;
+}
+
+PipelineStatus PipelineManager::status(PipelineHandle handle) const
+{
+    return slots[handle].status.load(std::memory_order_acquire);
+}
+
+uint32_t PipelineManager::pending() const
+{
+    return pending_count.load();
+}
+
+uint32_t PipelineManager::archive_misses() const
+{
+    return miss_count.load();
+}
+
+void PipelineManager::wait_all() const
+{
+    while (pending() > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
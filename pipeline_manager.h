@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include <Metal/Metal.hpp>
+
+#include "vertex_format.h"
+
+struct PipelineDesc {
+    std::string vertex_function;
+    std::string fragment_function;
+    MTL::PixelFormat color_format;
+    VertexLayout vertex_layout;
+    uint32_t max_amplification; // views per draw with vertex amplification, 1 without
+};
+
+typedef uint32_t PipelineHandle;
+
+enum class PipelineStatus {
+    Pending,
+    Ready,
+    Failed,
+};
+
+uint64_t hash_pipeline_desc(const PipelineDesc& desc);
+
+// Compiles render pipelines asynchronously on Metal's compiler threads.
+// Requests are deduplicated by descriptor hash and return a handle right
+// away; get() returns nullptr until the pipeline is ready, so callers
+// skip those draws. Pipelines are looked up in the binary archive at
+// archive_path first; ones it lacks are compiled, added to it, and the
+// archive is written again on cleanup so the next start loads compiled
+// code instead of compiling.
+class PipelineManager
+{
+public:
+    PipelineManager();
+
+    void init(MTL::Device* device, MTL::Library* library, const std::string& archive_path);
+    void cleanup();
+
+    PipelineHandle request(const PipelineDesc& desc);
+
+    MTL::RenderPipelineState* get(PipelineHandle handle) const;
+    PipelineStatus status(PipelineHandle handle) const;
+    uint32_t pending() const;
+    // pipelines that were compiled rather than loaded from the archive
+    uint32_t archive_misses() const;
+
+    void wait_all() const;
+
+private:
+    struct Slot {
+        uint64_t hash;
+        MTL::RenderPipelineState* state; // published by status
+        std::atomic<PipelineStatus> status;
+    };
+
+    // with from_archive a miss fails and compiles again without it, the
+    // handler owns descriptor
+    void compile(Slot* slot, MTL::RenderPipelineDescriptor* descriptor, bool from_archive);
+
+    MTL::Device* device;
+    MTL::Library* library;
+    MTL::BinaryArchive* archive;
+    bool archive_loaded;
+    std::string archive_path;
+
+    std::deque<Slot> slots;
+    std::unordered_map<uint64_t, PipelineHandle> handles;
+    std::atomic<uint32_t> pending_count;
+    std::atomic<uint32_t> miss_count;
+};
@@ -0,0 +1,195 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+uint64_t Profiler::now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Profiler::ThreadRing* Profiler::thread_ring()
+{
+    thread_local ThreadRing* ring = nullptr;
+
+    if (!ring) {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+
+        // rings are never freed, threads may record until exit
+        ring = new ThreadRing();
+        ring->thread = (uint32_t)rings.size();
+        rings.push_back(ring);
+    }
+
+    return ring;
+}
+
+void Profiler::record(const char* name, uint64_t start_ns, uint64_t end_ns)
+{
+    ThreadRing* ring = thread_ring();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+    Slot& slot = ring->slots[head & (RING_SIZE - 1)];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.end_ns.store(end_ns, std::memory_order_relaxed);
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::end_frame()
+{
+    std::vector<ThreadRing*> current;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        current = rings;
+    }
+
+    std::vector<Event> events;
+
+    for (ThreadRing* ring : current) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+
+        // the writer lapped us, the oldest events are gone
+        if (head - ring->tail > RING_SIZE) {
+            dropped += head - ring->tail - RING_SIZE;
+            ring->tail = head - RING_SIZE;
+        }
+
+        events.clear();
+
+        for (uint64_t i = ring->tail; i < head; i++) {
+            const Slot& slot = ring->slots[i & (RING_SIZE - 1)];
+            events.push_back({
+                slot.name.load(std::memory_order_relaxed),
+                slot.start_ns.load(std::memory_order_relaxed),
+                slot.end_ns.load(std::memory_order_relaxed),
+            });
+        }
+
+        // slots the writer reused while we copied may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t head_after = ring->head.load(std::memory_order_relaxed);
+        size_t first = 0;
+
+        if (head_after - ring->tail > RING_SIZE) {
+            first = (size_t)std::min<uint64_t>(head_after - RING_SIZE - ring->tail, events.size());
+            dropped += first;
+        }
+
+        ring->tail = head;
+
+        for (size_t i = first; i < events.size(); i++) {
+            const Event& e = events[i];
+
+            Stat* stat = nullptr;
+            for (Stat& s : stats) {
+                if (s.name == e.name || strcmp(s.name, e.name) == 0) {
+                    stat = &s;
+                    break;
+                }
+            }
+
+            if (!stat) {
+                stats.push_back({ e.name, 0, 0 });
+                stat = &stats.back();
+            }
+
+            stat->total_ns += e.end_ns - e.start_ns;
+            stat->count++;
+
+            if (trace_file)
+                trace.push_back({ e, ring->thread, frame });
+        }
+    }
+
+    if (trace.size() >= TRACE_CHUNK_EVENTS)
+        flush_trace();
+
+    frame++;
+    stats_frames++;
+
+    uint64_t now = now_ns();
+    if (stats_start == 0)
+        stats_start = now;
+
+    if (now - stats_start >= LOG_INTERVAL_NS) {
+        log_stats();
+        stats.clear();
+        stats_frames = 0;
+        stats_start = now;
+    }
+}
+
+void Profiler::log_stats()
+{
+    std::sort(stats.begin(), stats.end(), [](const Stat& a, const Stat& b) { return a.total_ns > b.total_ns; });
+
+    printf("profile: %llu frames, ms per frame", (unsigned long long)stats_frames);
+    for (const Stat& s : stats)
+        printf(" %s %.3f", s.name, (double)s.total_ns / stats_frames / 1e6);
+    printf("\n");
+}
+
+bool Profiler::open_trace(const std::string& path)
+{
+    trace_file = fopen(path.c_str(), "w");
+
+    if (!trace_file)
+        return false;
+
+    trace_origin = now_ns();
+    trace_failed = false;
+    trace_written = 0;
+    trace.clear();
+
+    fprintf(trace_file, "{\"traceEvents\":[\n");
+
+    return true;
+}
+
+// complete events, timestamps in microseconds since the trace was opened
+void Profiler::flush_trace()
+{
+    for (const TraceEvent& t : trace) {
+        int n = fprintf(trace_file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}\n",
+                        trace_written > 0 ? "," : "", t.event.name, t.thread,
+                        (double)(int64_t)(t.event.start_ns - trace_origin) / 1000.0,
+                        (double)(t.event.end_ns - t.event.start_ns) / 1000.0,
+                        (unsigned long long)t.frame);
+
+        trace_failed |= n < 0;
+        trace_written++;
+    }
+
+    trace.clear();
+}
+
+bool Profiler::close_trace()
+{
+    if (!trace_file)
+        return false;
+
+    flush_trace();
+    fprintf(trace_file, "]}\n");
+
+    bool ok = fclose(trace_file) == 0 && !trace_failed;
+    trace_file = nullptr;
+
+    return ok;
+}
+
+double cpu_seconds(const rusage& from, const rusage& to)
+{
+    auto seconds = [](const timeval& t) { return t.tv_sec + t.tv_usec / 1e6; };
+
+    return seconds(to.ru_utime) - seconds(from.ru_utime) + seconds(to.ru_stime) - seconds(from.ru_stime);
+}
+
+double percentile_ms(const std::vector<uint64_t>& latencies, double p)
+{
+    return latencies.empty() ? 0.0 : latencies[(size_t)(p * (latencies.size() - 1))] / 1e6;
+}
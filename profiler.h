@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Scope timer. Each thread records into its own ring buffer without
+// locking, end_frame() drains the rings on the main thread, sums the
+// scopes and once a second logs their average time per frame. With a
+// trace open the events also stream to a Chrome trace (chrome://tracing
+// or ui.perfetto.dev) in chunks. Everything compiles away unless built
+// with PROFILE defined.
+class Profiler
+{
+public:
+    struct Stat {
+        const char* name;
+        uint64_t total_ns;
+        uint32_t count;
+    };
+
+    static Profiler& instance()
+    {
+        static Profiler instance;
+
+        return instance;
+    }
+
+    static uint64_t now_ns();
+
+    // name must outlive the profiler, string literals in practice
+    void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+    void end_frame();
+
+    uint64_t dropped_events() const { return dropped; }
+
+    // events from here on are written to path until close_trace()
+    bool open_trace(const std::string& path);
+    bool close_trace();
+
+private:
+    static const uint64_t RING_SIZE = 1 << 16;
+    // events held before they are written out, about 2.5 MB
+    static const size_t TRACE_CHUNK_EVENTS = 1 << 16;
+    static const uint64_t LOG_INTERVAL_NS = 1000000000;
+
+    struct Event {
+        const char* name;
+        uint64_t start_ns;
+        uint64_t end_ns;
+    };
+
+    struct TraceEvent {
+        Event event;
+        uint32_t thread;
+        uint64_t frame;
+    };
+
+    // relaxed atomics so a lapping writer and the reader don't race,
+    // compile to plain loads and stores
+    struct Slot {
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> start_ns;
+        std::atomic<uint64_t> end_ns;
+    };
+
+    // written by the owning thread only, head publishes the events
+    struct ThreadRing {
+        uint32_t thread;
+        std::atomic<uint64_t> head{0};
+        uint64_t tail = 0;
+        Slot slots[RING_SIZE];
+    };
+
+    Profiler() {}
+    ThreadRing* thread_ring();
+    void flush_trace();
+    void log_stats();
+
+    std::mutex rings_mutex;
+    std::vector<ThreadRing*> rings;
+
+    FILE* trace_file = nullptr;
+    uint64_t trace_origin = 0;
+    bool trace_failed = false;
+    size_t trace_written = 0;
+    std::vector<TraceEvent> trace;
+
+    // summed over the frames since the last log
+    std::vector<Stat> stats;
+    uint64_t stats_frames = 0;
+    uint64_t stats_start = 0;
+
+    uint64_t frame = 0;
+    uint64_t dropped = 0;
+};
+
+// user plus system time between two getrusage() calls
+double cpu_seconds(const rusage& from, const rusage& to);
+
+// of nanosecond latencies, which must be sorted
+double percentile_ms(const std::vector<uint64_t>& latencies, double p);
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name) : name(name), start(Profiler::now_ns()) {}
+    ~ProfileScope() { Profiler::instance().record(name, start, Profiler::now_ns()); }
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#ifdef PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::instance().end_frame()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FRAME()
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "vertex_format.h"
+
+// what the renderer shares with the app and the benchmarks, kept free of
+// Metal so those build anywhere
+
+using RenderVertexLayout = VertexLayoutOf<VertexFormat::Short4Normalized, VertexFormat::UChar4Normalized>;
+
+struct UBO_VS {
+    glm::mat4 mvp;
+};
+
+// views rendered in one pass, side by side
+const size_t MAX_VIEWS = 6;
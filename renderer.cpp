@@ -1,11 +1,24 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <cstdlib>
 #include <cassert>
+#include <chrono>
+
+#include <dispatch/dispatch.h>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define CA_PRIVATE_IMPLEMENTATION
 #define MTL_PRIVATE_IMPLEMENTATION
 #include "renderer.h"
+#include "asset_cache.h"
+#include "embedded.h"
+#include "mesh_blob.h"
+#include "meshlet.h"
+#include "profiler.h"
+#include "scene.h"
+#include "simplify.h"
+#include "vertex_format.h"
 
 #define NSSTRING(s) (NS::String::string((s), NS::ASCIIStringEncoding))
 
@@ -14,23 +27,103 @@ enum {
 };
 
 typedef float vec2[2];
-typedef float vec3[3];
 typedef float quat[4];
 
-struct Vertex {
-    vec3 position; // attributes 0
-    vec3 color;    // attributes 1
+static MTL::IndexType mtl_index_type(IndexWidth width)
+{
+    return width == IndexWidth::U16 ? MTL::IndexTypeUInt16 : MTL::IndexTypeUInt32;
+}
+
+const float LOD_MAX_PIXEL_ERROR = 1.0f;
+// below this many draws a single encoder is cheaper than splitting
+const size_t PARALLEL_RECORD_MIN_DRAWS = 64;
+
+const char* ASSET_CACHE_DIR = "asset_cache";
+const char* PIPELINE_ARCHIVE_PATH = "pipelines.binarchive";
+const uint64_t MESH_HEAP_SIZE = 64ull << 20;
+// covers vertex, index and constant buffer offset rules
+const uint64_t MESH_HEAP_ALIGNMENT = 256;
+// resident mesh memory above this is evicted to the backing file
+const uint64_t MESH_RESIDENCY_BUDGET = 32ull << 20;
+const char* RESIDENCY_BACKING_NAME = "triangle_residency";
+const uint64_t ASSET_CACHE_MAX_BYTES = 1ull << 30;
+// uniforms get a slot per frame the GPU may still be reading
+const uint64_t MAX_FRAMES_IN_FLIGHT = 3;
+const uint64_t UNIFORM_SLOT_SIZE = (sizeof(UBO_VS) * MAX_VIEWS + 0xff) & ~0xff;
+const MTL::PixelFormat COLOR_FORMAT = MTL::PixelFormat::PixelFormatRGBA8Unorm_sRGB;
+// lowest dynamic resolution scale, per axis
+const float MIN_RESOLUTION_SCALE = 0.5f;
+
+// same layout as UpscaleParams in shader.metal
+struct UpscaleParams {
+    float uv_scale[2];
+    float uv_max[2];
 };
 
-Renderer::Renderer(unsigned int w, unsigned int h, std::string t) : title(t)
+// the processed mesh linked in by EMBED=1 builds, otherwise from the
+// asset cache, processed and stored on a miss
+static ProcessedMesh load_mesh(AssetCache& cache, const Mesh& mesh)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    ProcessedMesh out;
+    EmbeddedFile embedded;
+    const char* source = "embedded";
+
+    if (!embedded_file("mesh.blob", embedded) || !read_mesh_blob(embedded.data, embedded.size, out)) {
+        uint64_t key = processed_mesh_key(mesh);
+        MappedFile file;
+
+        bool hit = cache.load(key, file)
+            && read_mesh_blob(file.data() + AssetCache::payload_offset(), file.size() - AssetCache::payload_offset(), out);
+        source = hit ? "cache hit" : "cache miss";
+
+        if (!hit) {
+            out = process_mesh(mesh);
+
+            std::vector<uint8_t> blob = write_mesh_blob(out);
+            if (!cache.store(key, blob.data(), blob.size()))
+                std::cerr << "Failed to store processed mesh in cache\n";
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "mesh processing: " << elapsed.count() * 1000 << " ms (" << source << ")\n";
+
+    return out;
+}
+
+Renderer::Renderer(unsigned int w, unsigned int h, std::string t)
+    : culled_index_slot_size(0)
+    , current_lod(0)
+    , lod_enabled(true)
+    , frame_triangles(0)
+    , cull_stats()
+    , frame_index(0)
+    , completed_frame(0)
+    , target_frame_ms(0.0)
+    , scene_target(nullptr)
+    , upscale_sampler(nullptr)
+    , gpu_frame_ms(0.0)
+    , timed_frame(0)
+    , views(1)
+    , amplify_views(false)
+    , title(t)
 {
     viewport = { 0.0, 0.0, (double)w, (double)h, 0.1, 1000.0 };
+    frame_viewport = viewport;
 }
 
-void Renderer::init()
+void Renderer::init(JobSystem& job_system)
 {
     std::cout << "init\n";
 
+    jobs = &job_system;
+
+    init_time = std::chrono::steady_clock::now();
+    current_time = init_time;
+    first_frame_drawn = false;
+
     assert(SDL_Init(SDL_INIT_EVERYTHING) == 0);
 
     create_window();
@@ -69,31 +162,91 @@ void Renderer::init_resources()
     NS::Error* error;
     std::cout << "init resources\n";
 
-    Vertex vertex_data[3] = {
-        {{  1.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }},
-        {{ -1.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }},
-        {{  0.0f,  1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }},
-    };
+    Mesh mesh = scene_mesh();
+
+    AssetCache cache(ASSET_CACHE_DIR, ASSET_CACHE_MAX_BYTES);
+    ProcessedMesh processed = load_mesh(cache, mesh);
 
-    uint32_t index_data[3] = { 0, 1, 2 };
+    const PackedMesh& packed = processed.packed;
+    mesh_chunks = packed.chunks;
+    mesh_lods = packed.lods;
+    meshlets = std::move(processed.meshlets);
+
+    std::cout << "index buffer: " << packed.index_data.size() << " bytes ("
+              << mesh.indices.size() * sizeof(uint32_t) << " as u32)\n";
+
+    QuantizedVertices vertices = quantize_vertices<RenderVertexLayout>(packed.vertices);
+    position_transform = vertices.transform;
+
+    std::cout << "vertex buffer: " << vertices.data.size() << " bytes ("
+              << packed.vertices.size() * sizeof(Vertex) << " as float, "
+              << measure_vertex_decode<RenderVertexLayout>(vertices, 1000) / 1e6 << " M vertices/s decode)\n";
 
     // vertex buffer
-    vertex_buffer = device->newBuffer(sizeof(Vertex) * 3, MTL::CPUCacheModeDefaultCache);
-    vertex_buffer->setLabel(NSSTRING("VBO"));
-    memcpy(vertex_buffer->contents(), vertex_data, sizeof(Vertex) * 3);
+    // mesh data is sub-allocated from shared heap buffers and may be
+    // evicted to disk when over budget
+    mesh_heap.init(device, MESH_HEAP_SIZE);
+
+    ResidencyManager::Callbacks callbacks;
+    callbacks.allocate = [this](ResourceHandle handle, uint64_t size) -> void* {
+        BufferAllocation a;
+        if (!mesh_heap.allocate(size, MESH_HEAP_ALIGNMENT, a))
+            return nullptr;
+
+        mesh_allocs[handle.id] = a;
+        return (uint8_t*)a.buffer->contents() + a.offset;
+    };
+    callbacks.release = [this](ResourceHandle handle) {
+        mesh_heap.free(mesh_allocs[handle.id]);
+        mesh_allocs.erase(handle.id);
+    };
+
+    residency.init(RESIDENCY_BACKING_NAME, MESH_RESIDENCY_BUDGET, callbacks);
+
+    vertex_resource = residency.add(vertices.data.size());
+
+    if (vertex_resource == NULL_HANDLE) {
+        std::cerr << "Failed to allocate vertex buffer\n";
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(residency.use(vertex_resource, frame_index), vertices.data.data(), vertices.data.size());
+
+    {
+        Tlsf::Stats stats = mesh_heap.stats();
+        std::cout << "mesh heap: " << stats.used << " / " << stats.size << " bytes in "
+                  << stats.allocations << " allocations, fragmentation " << stats.fragmentation << "\n";
+    }
 
-    // index buffer
-    index_buffer = device->newBuffer(sizeof(uint32_t) * 3, MTL::CPUCacheModeDefaultCache);
-    index_buffer->setLabel(NSSTRING("IBO"));
-    memcpy(index_buffer->contents(), index_data, sizeof(uint32_t) * 3);
+    // culled index buffer, rewritten every frame into the frame's slot.
+    // worst case is every chunk fully visible plus alignment
+    culled_index_slot_size = (packed.index_data.size() + 4 * packed.chunks.size() + 0xff) & ~0xffull;
+    culled_index_buffer = create_buffer(culled_index_slot_size * MAX_FRAMES_IN_FLIGHT, "Culled IBO");
 
     // uniform buffer
-    uniform_buffer = device->newBuffer((sizeof(UBO_VS) + 0xff) & ~0xff, MTL::CPUCacheModeDefaultCache);
-    uniform_buffer->setLabel(NSSTRING("UBO"));
+    uniform_buffer = create_buffer(UNIFORM_SLOT_SIZE * MAX_FRAMES_IN_FLIGHT, "UBO");
 
-    // loading shaders
-    NS::String* filePath = NSSTRING("shader.metallib");
-    library = device->newLibrary(filePath, &error);
+    // loading shaders, from the executable when embedded
+    {
+        auto start = std::chrono::steady_clock::now();
+        EmbeddedFile embedded;
+        bool is_embedded = embedded_file("shader.metallib", embedded);
+
+        if (is_embedded) {
+            // static data, nothing to free
+            dispatch_data_t data = dispatch_data_create(embedded.data, embedded.size, nullptr, ^{});
+            library = device->newLibrary(data, &error);
+            dispatch_release(data);
+        }
+        else {
+            NS::String* filePath = NSSTRING("shader.metallib");
+            library = device->newLibrary(filePath, &error);
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "shader library: " << elapsed.count() * 1000 << " ms ("
+                  << (is_embedded ? "embedded" : "file") << ")\n";
+    }
 
     if(error) {
         std::cerr << "Error when loading default library\n";
@@ -105,52 +258,47 @@ void Renderer::init_resources()
         exit(EXIT_FAILURE);
     }
 
-    vert_fun = library->newFunction(NSSTRING("VS"));
-    frag_fun = library->newFunction(NSSTRING("FS"));
+    // pipelines compile in the background, draw() skips them until ready
+    pipelines.init(device, library, PIPELINE_ARCHIVE_PATH);
 
-    if (!vert_fun) {
-        std::cerr << "Failed to load VS function from library\n";
-        exit(EXIT_FAILURE);
-    }
+    PipelineDesc pipeline_desc;
+    pipeline_desc.vertex_function = "VS";
+    pipeline_desc.fragment_function = "FS";
+    pipeline_desc.color_format = COLOR_FORMAT;
+    pipeline_desc.vertex_layout = RenderVertexLayout::layout();
+    pipeline_desc.max_amplification = 1;
 
-    if (!frag_fun) {
-        std::cerr << "Failed to load FS function from library\n";
-        exit(EXIT_FAILURE);
-    }
+    pipeline = pipelines.request(pipeline_desc);
 
-    // pipeline
-    MTL::RenderPipelineDescriptor* descriptor = MTL::RenderPipelineDescriptor::alloc()->init();
-    descriptor->setLabel(NSSTRING("Simple pipeline"));
-    descriptor->setVertexFunction(vert_fun);
-    descriptor->setFragmentFunction(frag_fun);
-    descriptor->colorAttachments()->object(0)->setPixelFormat(MTL::PixelFormat::PixelFormatRGBA8Unorm_sRGB);
-
-    MTL::VertexDescriptor* vert_desc = MTL::VertexDescriptor::vertexDescriptor();
-    // position attr
-    vert_desc->attributes()->object(0)->setFormat(MTL::VertexFormatFloat3);
-    vert_desc->attributes()->object(0)->setOffset(0);
-    vert_desc->attributes()->object(0)->setBufferIndex(0);
-    // color attr
-    vert_desc->attributes()->object(1)->setFormat(MTL::VertexFormatFloat3);
-    vert_desc->attributes()->object(1)->setOffset(sizeof(float) * 3);
-    vert_desc->attributes()->object(1)->setBufferIndex(0);
-    // layout
-    vert_desc->layouts()->object(0)->setStepFunction(MTL::VertexStepFunctionPerVertex);
-    vert_desc->layouts()->object(0)->setStride(sizeof(Vertex));
-
-    descriptor->setVertexDescriptor(vert_desc);
-
-    pipeline_state = device->newRenderPipelineState(descriptor, &error);
-
-    if (!pipeline_state) {
-        std::cout << "Failed to create pipeline state: " << error->localizedDescription()->utf8String() << "\n";
-        exit(EXIT_FAILURE);
+    if (views > 1) {
+        amplify_views = device->supportsVertexAmplificationCount(views);
+
+        pipeline_desc.vertex_function = amplify_views ? "VS_amplified" : "VS_instanced";
+        pipeline_desc.max_amplification = amplify_views ? (uint32_t)views : 1;
+
+        multiview_pipeline = pipelines.request(pipeline_desc);
+        pipeline_desc.max_amplification = 1;
+
+        std::cout << "multi view: " << views << " views, " << (amplify_views ? "vertex amplification" : "instanced") << "\n";
     }
 
-    vert_fun->release();
-    frag_fun->release();
-    library->release();
-    descriptor->release();
+    // the upscale pass only runs with a frame time target, it reads no
+    // vertices so the layout is just unused
+    if (target_frame_ms > 0.0) {
+        pipeline_desc.vertex_function = "upscale_VS";
+        pipeline_desc.fragment_function = "upscale_FS";
+
+        upscale_pipeline = pipelines.request(pipeline_desc);
+
+        MTL::SamplerDescriptor* sampler_desc = MTL::SamplerDescriptor::alloc()->init();
+        sampler_desc->setMinFilter(MTL::SamplerMinMagFilterLinear);
+        sampler_desc->setMagFilter(MTL::SamplerMinMagFilterLinear);
+        sampler_desc->setSAddressMode(MTL::SamplerAddressModeClampToEdge);
+        sampler_desc->setTAddressMode(MTL::SamplerAddressModeClampToEdge);
+
+        upscale_sampler = device->newSamplerState(sampler_desc);
+        sampler_desc->release();
+    }
 }
 
 void Renderer::cleanup()
@@ -171,27 +319,66 @@ void Renderer::cleanup_resources()
 {
     std::cout << "cleanup resources\n";
 
-    vertex_buffer->release();
-    index_buffer->release();
-    uniform_buffer->release();
+    buffers.destroy(culled_index_buffer, frame_index);
+    buffers.destroy(uniform_buffer, frame_index);
+
+    // an empty command buffer completes after every frame queued before it
+    MTL::CommandBuffer* fence = command_queue->commandBuffer();
+    fence->commit();
+    fence->waitUntilCompleted();
+
+    buffers.flush();
+
+    if (scene_target)
+        scene_target->release();
+    if (upscale_sampler)
+        upscale_sampler->release();
 
-    pipeline_state->release();
+    residency.remove(vertex_resource);
+    residency.cleanup();
+    mesh_heap.cleanup();
+
+    pipelines.cleanup();
+    library->release();
 }
 
-void Renderer::draw()
+void Renderer::draw(const std::function<void(UBO_VS*)>& late_latch)
 {
+    PROFILE_SCOPE("draw");
     // update_uniform();
 
     NS::AutoreleasePool* pool = NS::AutoreleasePool::alloc()->init();
     MTL::CommandBuffer* command_buffer = command_queue->commandBuffer();
     command_buffer->setLabel(NSSTRING("My command"));
 
-    CA::MetalDrawable* drawable = layer->nextDrawable();
+    CA::MetalDrawable* drawable;
+    {
+        PROFILE_SCOPE("next drawable");
+        drawable = layer->nextDrawable();
+    }
 
     assert(drawable);
 
+    // falls back to full resolution until the upscale pipeline is ready
+    bool scaled = target_frame_ms > 0.0 && pipelines.get(upscale_pipeline);
+    float scale = scaled ? resolution.scale() : 1.0f;
+
+    if (scaled && !scene_target) {
+        MTL::TextureDescriptor* texture_desc = MTL::TextureDescriptor::texture2DDescriptor(
+                COLOR_FORMAT, (NS::UInteger)viewport.width, (NS::UInteger)viewport.height, false);
+        texture_desc->setUsage(MTL::TextureUsageRenderTarget | MTL::TextureUsageShaderRead);
+        texture_desc->setStorageMode(MTL::StorageModePrivate);
+
+        scene_target = device->newTexture(texture_desc);
+        scene_target->setLabel(NSSTRING("Scene target"));
+    }
+
+    frame_viewport = viewport;
+    frame_viewport.width = std::floor(viewport.width * scale);
+    frame_viewport.height = std::floor(viewport.height * scale);
+
     MTL::RenderPassDescriptor* renderpass_desc = MTL::RenderPassDescriptor::renderPassDescriptor();
-    renderpass_desc->colorAttachments()->object(0)->setTexture(drawable->texture());
+    renderpass_desc->colorAttachments()->object(0)->setTexture(scaled ? scene_target : drawable->texture());
     renderpass_desc->colorAttachments()->object(0)->setLoadAction(MTL::LoadActionClear);
 
     MTL::ClearColor clearcol;
@@ -204,28 +391,101 @@ void Renderer::draw()
 
     assert(renderpass_desc);
 
-    MTL::RenderCommandEncoder* encoder = command_buffer->renderCommandEncoder(renderpass_desc);
-    encoder->setLabel(NSSTRING("My encoder"));
+    MTL::RenderPipelineState* pipeline_state = pipelines.get(views > 1 ? multiview_pipeline : pipeline);
+
+    if (pipeline_state && !first_frame_drawn) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - init_time;
+        std::cout << "time to first frame: " << elapsed.count() * 1000 << " ms\n";
+        first_frame_drawn = true;
+    }
 
-    encoder->setViewport(viewport);
+    frame_triangles = 0;
 
-    encoder->setRenderPipelineState(pipeline_state);
-    encoder->setCullMode(MTL::CullModeNone);
+    // reloads the vertex data first if it was evicted, without it the
+    // frame is just cleared
+    if (pipeline_state && !residency.use(vertex_resource, frame_index + 1))
+        pipeline_state = nullptr;
 
-    encoder->setVertexBuffer(vertex_buffer, 0, 0);
-    encoder->setVertexBuffer(uniform_buffer, 0, 1);
+    if (pipeline_state)
+        frame_triangles = (cull_stats.triangles - cull_stats.triangles_culled) * (uint32_t)views;
 
+    // a grid of views over the frame's viewport
+    {
+        size_t columns = (size_t)std::ceil(std::sqrt((double)views));
+        size_t rows = (views + columns - 1) / columns;
+
+        for (size_t i = 0; i < views; i++) {
+            MTL::Viewport& v = view_viewports[i];
+
+            v = frame_viewport;
+            v.width = frame_viewport.width / columns;
+            v.height = frame_viewport.height / rows;
+            v.originX = frame_viewport.originX + v.width * (i % columns);
+            v.originY = frame_viewport.originY + v.height * (i / columns);
+        }
+    }
 
-    encoder->drawIndexedPrimitives(
-            MTL::PrimitiveTypeTriangle,
-            NS::UInteger(3),
-            MTL::IndexTypeUInt32,
-            index_buffer,
-            NS::UInteger(0));
+    size_t draw_count = pipeline_state ? culled_chunks.size() : 0;
 
-    encoder->endEncoding();
+    if (draw_count >= PARALLEL_RECORD_MIN_DRAWS && jobs->thread_count() > 1) {
+        // sub-encoders execute in the order they were created
+        MTL::ParallelRenderCommandEncoder* parallel = command_buffer->parallelRenderCommandEncoder(renderpass_desc);
+        parallel->setLabel(NSSTRING("My parallel encoder"));
+
+        size_t encoder_count = jobs->thread_count();
+        size_t per_encoder = (draw_count + encoder_count - 1) / encoder_count;
+        std::vector<MTL::RenderCommandEncoder*> encoders(encoder_count);
+
+        for (MTL::RenderCommandEncoder*& encoder : encoders)
+            encoder = parallel->renderCommandEncoder();
+
+        jobs->parallel_for(encoder_count, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                size_t first = std::min(i * per_encoder, draw_count);
+                size_t count = std::min(per_encoder, draw_count - first);
+
+                record_draws(encoders[i], pipeline_state, first, count);
+                encoders[i]->endEncoding();
+            }
+        });
+
+        parallel->endEncoding();
+    }
+    else {
+        MTL::RenderCommandEncoder* encoder = command_buffer->renderCommandEncoder(renderpass_desc);
+        encoder->setLabel(NSSTRING("My encoder"));
+
+        // pending pipelines just clear the frame
+        if (pipeline_state)
+            record_draws(encoder, pipeline_state, 0, draw_count);
+        else
+            encoder->setViewport(frame_viewport);
+
+        encoder->endEncoding();
+    }
+
+    if (scaled)
+        record_upscale(command_buffer, drawable->texture());
+
+    // everything is encoded, the uniforms are only read once the GPU runs
+    // the frame, so they can still change up to the commit
+    if (late_latch) {
+        PROFILE_SCOPE("late latch");
+        late_latch((UBO_VS*)uniform_slot());
+    }
+
+    uint64_t frame = ++frame_index;
+    command_buffer->addCompletedHandler([this, frame](MTL::CommandBuffer* buffer) {
+        gpu_frame_ms.store((buffer->GPUEndTime() - buffer->GPUStartTime()) * 1000.0, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(completed_mutex);
+            completed_frame.store(frame, std::memory_order_release);
+        }
+        completed_cv.notify_one();
+    });
 
     command_buffer->presentDrawable(drawable);
+    last_commit_time = std::chrono::steady_clock::now();
     command_buffer->commit();
 
     pool->release();
@@ -233,14 +493,50 @@ void Renderer::draw()
 
 float Renderer::frame_start()
 {
+    uint64_t completed = completed_frame.load(std::memory_order_acquire);
+
+    // the uniform slot this frame writes must be out of GPU use, sleep
+    // until the completed handler says it is
+    if (frame_index - completed >= MAX_FRAMES_IN_FLIGHT) {
+        PROFILE_SCOPE("wait for gpu");
+        std::unique_lock<std::mutex> lock(completed_mutex);
+
+        completed_cv.wait(lock, [this, &completed] {
+            completed = completed_frame.load(std::memory_order_acquire);
+            return frame_index - completed < MAX_FRAMES_IN_FLIGHT;
+        });
+    }
+
+    buffers.collect(completed);
+    residency.end_frame(completed);
+
+    // GPU time of the newest completed frame steers the resolution,
+    // frames still in flight from before a change don't count
+    if (target_frame_ms > 0.0 && completed > timed_frame) {
+        float scale = resolution.scale();
+
+        bool changed = resolution.update(gpu_frame_ms.load(std::memory_order_relaxed)) != scale;
+        timed_frame = changed ? frame_index : completed;
+    }
+
     last_time = current_time;
-    current_time = SDL_GetTicks();
+    current_time = std::chrono::steady_clock::now();
 
-    float delta_time = (float)(current_time - last_time) / 1000;
+    float delta_time = std::chrono::duration<float>(current_time - last_time).count();
 
     // show FPS
     {
-        std::string s = title + " FPS: " + std::to_string(1.0f / delta_time);
+        float fps = delta_time > 0.0f ? 1.0f / delta_time : 0.0f;
+        const ResidencyManager::FrameStats& residency_stats = residency.last_frame_stats();
+        std::string s = title + " FPS: " + std::to_string(fps)
+            + " Triangles: " + std::to_string(frame_triangles) + (lod_enabled ? "" : " (LOD off)")
+            + " Culled: " + std::to_string(cull_stats.triangles_culled)
+            + " (" + std::to_string(cull_stats.cull_ms) + " ms)"
+            + " Resident: " + std::to_string(residency_stats.resident_bytes >> 10) + " KB"
+            + " Evictions: " + std::to_string(residency_stats.evictions)
+            + " Reloads: " + std::to_string(residency_stats.reloads)
+            + " (" + std::to_string(residency_stats.reload_ms) + " ms)"
+            + (target_frame_ms > 0.0 ? " Scale: " + std::to_string(resolution.scale()) : "");
         SDL_SetWindowTitle(sdl_window, s.c_str());
     }
 
@@ -249,5 +545,156 @@ float Renderer::frame_start()
 
 void Renderer::update_uniform(UBO_VS* data)
 {
-    memcpy(uniform_buffer->contents(), data, sizeof(UBO_VS));
+    update_uniforms(data, 1);
+}
+
+void Renderer::update_uniforms(const UBO_VS* data, size_t count)
+{
+    PROFILE_SCOPE("uniform update");
+    memcpy(uniform_slot(), data, sizeof(UBO_VS) * std::min(count, MAX_VIEWS));
+}
+
+void Renderer::set_view_count(size_t count)
+{
+    views = std::max<size_t>(1, std::min(count, MAX_VIEWS));
+}
+
+float Renderer::view_aspect() const
+{
+    size_t columns = (size_t)std::ceil(std::sqrt((double)views));
+    size_t rows = (views + columns - 1) / columns;
+
+    return (float)((viewport.width / columns) / (viewport.height / rows));
+}
+
+void Renderer::select_lod(float distance, float fov_y)
+{
+    current_lod = lod_enabled ? ::select_lod(mesh_lods, distance, fov_y, (float)viewport.height, LOD_MAX_PIXEL_ERROR) : 0;
+}
+
+void Renderer::toggle_lod()
+{
+    lod_enabled = !lod_enabled;
+}
+
+void Renderer::update_visibility(const glm::mat4& mvp, const glm::vec3& camera_position)
+{
+    update_visibility(&mvp, &camera_position, 1);
+}
+
+void Renderer::update_visibility(const glm::mat4* mvps, const glm::vec3* camera_positions, size_t count)
+{
+    PROFILE_SCOPE("cull");
+    CullView cull_views[MAX_VIEWS];
+    count = std::min(count, MAX_VIEWS);
+
+    for (size_t i = 0; i < count; i++) {
+        frustum_planes(&mvps[i][0][0], cull_views[i].planes);
+        memcpy(cull_views[i].camera_position, &camera_positions[i][0], sizeof(float) * 3);
+    }
+
+    const PackedLod& lod = mesh_lods[current_lod];
+
+    culled_index_data.clear();
+    culled_chunks.clear();
+    cull_meshlets(mesh_chunks, meshlets, lod.first_chunk, lod.chunk_count,
+                  cull_views, count, culled_index_data, culled_chunks, cull_stats, *jobs);
+
+    uint8_t* slot = (uint8_t*)buffers.get(culled_index_buffer)->contents() + culled_index_slot_offset();
+    memcpy(slot, culled_index_data.data(), culled_index_data.size());
+}
+
+void Renderer::record_draws(MTL::RenderCommandEncoder* encoder, MTL::RenderPipelineState* pipeline_state,
+                            size_t first_chunk, size_t chunk_count)
+{
+    PROFILE_SCOPE("encode");
+    const BufferAllocation& vertex_alloc = mesh_allocs.at(vertex_resource.id);
+
+    if (views > 1) {
+        encoder->setViewports(view_viewports, views);
+        if (amplify_views)
+            encoder->setVertexAmplificationCount(views, nullptr);
+    }
+    else {
+        encoder->setViewport(frame_viewport);
+    }
+
+    encoder->setRenderPipelineState(pipeline_state);
+    // meshlet cone culling assumes the default clockwise front faces
+    encoder->setFrontFacingWinding(MTL::WindingClockwise);
+    encoder->setCullMode(MTL::CullModeBack);
+
+    encoder->setVertexBuffer(vertex_alloc.buffer, vertex_alloc.offset, 0);
+    encoder->setVertexBuffer(buffers.get(uniform_buffer), (frame_index % MAX_FRAMES_IN_FLIGHT) * UNIFORM_SLOT_SIZE, 1);
+    encoder->setVertexBytes(&position_transform, sizeof(PositionTransform), 2);
+
+    MTL::Buffer* index_buffer = buffers.get(culled_index_buffer);
+    uint64_t index_slot = culled_index_slot_offset();
+    // instancing draws each view as an instance
+    size_t instances = views > 1 && !amplify_views ? views : 1;
+
+    for (size_t i = first_chunk; i < first_chunk + chunk_count; i++) {
+        const MeshChunk& chunk = culled_chunks[i];
+
+        encoder->drawIndexedPrimitives(
+                MTL::PrimitiveTypeTriangle,
+                NS::UInteger(chunk.index_count),
+                mtl_index_type(chunk.index_width),
+                index_buffer,
+                NS::UInteger(index_slot + chunk.index_offset),
+                NS::UInteger(instances),
+                NS::Integer(chunk.vertex_offset),
+                NS::UInteger(0));
+    }
+}
+
+void Renderer::record_upscale(MTL::CommandBuffer* command_buffer, MTL::Texture* target)
+{
+    PROFILE_SCOPE("upscale");
+
+    MTL::RenderPassDescriptor* renderpass_desc = MTL::RenderPassDescriptor::renderPassDescriptor();
+    renderpass_desc->colorAttachments()->object(0)->setTexture(target);
+    renderpass_desc->colorAttachments()->object(0)->setLoadAction(MTL::LoadActionDontCare);
+
+    // the rendered region, and half a texel in from its edge
+    UpscaleParams params = {
+        { (float)(frame_viewport.width / viewport.width), (float)(frame_viewport.height / viewport.height) },
+        { (float)((frame_viewport.width - 0.5) / viewport.width), (float)((frame_viewport.height - 0.5) / viewport.height) },
+    };
+
+    MTL::RenderCommandEncoder* encoder = command_buffer->renderCommandEncoder(renderpass_desc);
+    encoder->setLabel(NSSTRING("Upscale encoder"));
+    encoder->setRenderPipelineState(pipelines.get(upscale_pipeline));
+    encoder->setVertexBytes(&params, sizeof(params), 0);
+    encoder->setFragmentBytes(&params, sizeof(params), 0);
+    encoder->setFragmentTexture(scene_target, 0);
+    encoder->setFragmentSamplerState(upscale_sampler, 0);
+    encoder->drawPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(0), NS::UInteger(3));
+    encoder->endEncoding();
+}
+
+void Renderer::set_target_frame_ms(double target_ms)
+{
+    target_frame_ms = target_ms;
+
+    if (target_ms > 0.0)
+        resolution.init(target_ms, MIN_RESOLUTION_SCALE);
+}
+
+void* Renderer::uniform_slot()
+{
+    return (uint8_t*)buffers.get(uniform_buffer)->contents() + (frame_index % MAX_FRAMES_IN_FLIGHT) * UNIFORM_SLOT_SIZE;
+}
+
+uint64_t Renderer::culled_index_slot_offset() const
+{
+    return (frame_index % MAX_FRAMES_IN_FLIGHT) * culled_index_slot_size;
+}
+
+ResourceHandle Renderer::create_buffer(size_t size, const char* label)
+{
+    MTL::Buffer* buffer = device->newBuffer(size, MTL::CPUCacheModeDefaultCache);
+    buffer->setLabel(NSSTRING(label));
+
+    return buffers.create(buffer);
 }
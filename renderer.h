@@ -1,33 +1,79 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <SDL2/SDL.h>
 #include <Metal/Metal.hpp>
 
 #include <glm/glm.hpp>
 
-struct UBO_VS {
-    glm::mat4 mvp;
-};
+#include "buffer_heap.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "pipeline_manager.h"
+#include "render_types.h"
+#include "residency.h"
+#include "resolution_controller.h"
+#include "resource_manager.h"
+#include "vertex_format.h"
 
 class Renderer
 {
 public:
     Renderer(unsigned int width, unsigned int height, std::string name);
 
-    void init();
+    void init(JobSystem& jobs);
     void cleanup();
-    void draw();
+    // late_latch, when given, rewrites the frame's uniforms (one per
+    // view) right before the commit, after everything else is encoded
+    void draw(const std::function<void(UBO_VS*)>& late_latch = nullptr);
     float frame_start();
 
     void update_uniform(UBO_VS* data);
+    void update_uniforms(const UBO_VS* views, size_t count);
+
+    // splits the window into count viewports drawn in a single pass,
+    // call before init
+    void set_view_count(size_t count);
+    size_t view_count() const { return views; }
+    float view_aspect() const;
+
+    // renders offscreen at whatever resolution holds target_ms of GPU time
+    // per frame and upscales to the window, 0 renders at full resolution.
+    // call before init(), which only sets up upscaling for a target
+    void set_target_frame_ms(double target_ms);
+
+    std::chrono::steady_clock::time_point commit_time() const { return last_commit_time; }
+
+    // distance to the mesh in object space units
+    void select_lod(float distance, float fov_y);
+    void toggle_lod();
+
+    // meshlet culling for the current lod, camera position in object space
+    void update_visibility(const glm::mat4& mvp, const glm::vec3& camera_position);
+    // keeps whatever any of the views sees
+    void update_visibility(const glm::mat4* mvps, const glm::vec3* camera_positions, size_t count);
 
 private:
     void create_window();
     void init_resources();
     void cleanup_resources();
 
+    ResourceHandle create_buffer(size_t size, const char* label);
+    void* uniform_slot();
+    uint64_t culled_index_slot_offset() const;
+    void record_draws(MTL::RenderCommandEncoder* encoder, MTL::RenderPipelineState* pipeline_state,
+                      size_t first_chunk, size_t chunk_count);
+    void record_upscale(MTL::CommandBuffer* command_buffer, MTL::Texture* target);
+
     SDL_Window* sdl_window;
     SDL_MetalView metal_view;
     CA::MetalLayer* layer;
@@ -35,21 +81,72 @@ private:
     MTL::Device* device;
     MTL::CommandQueue* command_queue;
 
+    JobSystem* jobs;
+
     // Resources
-    MTL::Buffer* vertex_buffer;
-    MTL::Buffer* index_buffer;
-    MTL::Buffer* uniform_buffer;
+    ResourceManager<MTL::Buffer*, ReleaseObject> buffers;
+    // one slot of culled_index_slot_size bytes per frame in flight
+    ResourceHandle culled_index_buffer;
+    uint64_t culled_index_slot_size;
+    ResourceHandle uniform_buffer;
+
+    // mesh buffers live in the heap while resident, keyed by residency handle
+    BufferHeap mesh_heap;
+    ResidencyManager residency;
+    std::unordered_map<uint32_t, BufferAllocation> mesh_allocs;
+    ResourceHandle vertex_resource;
+
+    std::vector<MeshChunk> mesh_chunks;
+    std::vector<PackedLod> mesh_lods;
+    size_t current_lod;
+    bool lod_enabled;
+    uint32_t frame_triangles;
+
+    MeshletMesh meshlets;
+    std::vector<uint8_t> culled_index_data;
+    std::vector<MeshChunk> culled_chunks;
+    MeshletCullStats cull_stats;
+
+    // frames submitted and completed by the GPU, for deferred destruction
+    uint64_t frame_index;
+    std::atomic<uint64_t> completed_frame;
+    // signalled by the completed handler, frame_start() blocks on it
+    std::mutex completed_mutex;
+    std::condition_variable completed_cv;
+    PositionTransform position_transform;
 
     MTL::Library* library;
-    MTL::Function* vert_fun;
-    MTL::Function* frag_fun;
 
-    MTL::RenderPipelineState* pipeline_state;
+    PipelineManager pipelines;
+    PipelineHandle pipeline;
+
+    // multi view, amplified where the device supports the view count and
+    // instanced otherwise
+    size_t views;
+    bool amplify_views;
+    PipelineHandle multiview_pipeline;
+    MTL::Viewport view_viewports[MAX_VIEWS];
+
+    // dynamic resolution, frames render into the top left of scene_target
+    ResolutionController resolution;
+    double target_frame_ms;
+    MTL::Texture* scene_target;
+    MTL::SamplerState* upscale_sampler;
+    PipelineHandle upscale_pipeline;
+    std::atomic<double> gpu_frame_ms;
+    // frames up to this one are timed already or were rendered at an
+    // earlier scale
+    uint64_t timed_frame;
 
     // Misc
     MTL::Viewport viewport;
+    MTL::Viewport frame_viewport;
     std::string title;
 
-    Uint32 last_time;
-    Uint32 current_time;
+    std::chrono::steady_clock::time_point init_time;
+    bool first_frame_drawn;
+    std::chrono::steady_clock::time_point last_commit_time;
+
+    std::chrono::steady_clock::time_point last_time;
+    std::chrono::steady_clock::time_point current_time;
 };
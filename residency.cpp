@@ -0,0 +1,226 @@
+#include "residency.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+static bool write_all(int fd, const void* data, uint64_t size, uint64_t offset)
+{
+    const uint8_t* p = (const uint8_t*)data;
+
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, (size_t)size, (off_t)offset);
+        if (n <= 0)
+            return false;
+
+        p += n;
+        size -= (uint64_t)n;
+        offset += (uint64_t)n;
+    }
+
+    return true;
+}
+
+static bool read_all(int fd, void* data, uint64_t size, uint64_t offset)
+{
+    uint8_t* p = (uint8_t*)data;
+
+    while (size > 0) {
+        ssize_t n = pread(fd, p, (size_t)size, (off_t)offset);
+        if (n <= 0)
+            return false;
+
+        p += n;
+        size -= (uint64_t)n;
+        offset += (uint64_t)n;
+    }
+
+    return true;
+}
+
+void ResidencyManager::init(const std::string& name, uint64_t b, Callbacks c)
+{
+    callbacks = c;
+    budget = b;
+
+    // a fresh file per run that goes away with the descriptor, even if
+    // the process dies
+    std::error_code ec;
+    std::string path = (std::filesystem::temp_directory_path(ec) / (name + ".XXXXXX")).string();
+    backing_fd = mkstemp(&path[0]);
+
+    if (backing_fd < 0)
+        std::cerr << "Failed to open residency backing file, eviction disabled\n";
+    else
+        unlink(path.c_str());
+}
+
+void ResidencyManager::cleanup()
+{
+    for (Entry& entry : entries) {
+        if (entry.contents)
+            callbacks.release(entry.handle);
+    }
+
+    entries = ResourcePool<Entry>();
+    resident_bytes = 0;
+    backing_end = 0;
+
+    if (backing_fd >= 0) {
+        close(backing_fd);
+        backing_fd = -1;
+    }
+}
+
+ResourceHandle ResidencyManager::add(uint64_t size)
+{
+    ResourceHandle handle = entries.create({ NULL_HANDLE, size, 0, NOT_BACKED, nullptr, true });
+    Entry* entry = entries.get(handle);
+
+    entry->handle = handle;
+    entry->contents = callbacks.allocate(handle, size);
+
+    if (!entry->contents) {
+        entries.remove(handle, nullptr);
+        return NULL_HANDLE;
+    }
+
+    resident_bytes += size;
+
+    return handle;
+}
+
+void ResidencyManager::remove(ResourceHandle handle)
+{
+    Entry* entry = entries.get(handle);
+
+    if (!entry)
+        return;
+
+    if (entry->contents) {
+        callbacks.release(handle);
+        resident_bytes -= entry->size;
+    }
+
+    entries.remove(handle, nullptr);
+}
+
+void* ResidencyManager::use(ResourceHandle handle, uint64_t frame)
+{
+    Entry* entry = entries.get(handle);
+
+    if (!entry)
+        return nullptr;
+
+    entry->last_used = std::max(entry->last_used, frame);
+
+    if (entry->contents)
+        return entry->contents;
+
+    auto start = std::chrono::steady_clock::now();
+
+    entry->contents = callbacks.allocate(handle, entry->size);
+
+    if (!entry->contents)
+        return nullptr;
+
+    if (!read_all(backing_fd, entry->contents, entry->size, entry->file_offset)) {
+        std::cerr << "Failed to reload evicted resource\n";
+        callbacks.release(handle);
+        entry->contents = nullptr;
+        return nullptr;
+    }
+
+    resident_bytes += entry->size;
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    stats.reloads++;
+    stats.reload_ms += elapsed.count();
+
+    return entry->contents;
+}
+
+bool ResidencyManager::resident(ResourceHandle handle)
+{
+    Entry* entry = entries.get(handle);
+
+    return entry && entry->contents;
+}
+
+void ResidencyManager::mark_dirty(ResourceHandle handle)
+{
+    Entry* entry = entries.get(handle);
+
+    if (entry)
+        entry->dirty = true;
+}
+
+bool ResidencyManager::evict(Entry& entry)
+{
+    if (backing_fd < 0)
+        return false;
+
+    // regions are sized once and reused, clean resources skip the write
+    if (entry.file_offset == NOT_BACKED) {
+        entry.file_offset = backing_end;
+        backing_end += entry.size;
+        entry.dirty = true;
+    }
+
+    if (entry.dirty) {
+        if (!write_all(backing_fd, entry.contents, entry.size, entry.file_offset))
+            return false;
+
+        entry.dirty = false;
+    }
+
+    callbacks.release(entry.handle);
+    entry.contents = nullptr;
+    resident_bytes -= entry.size;
+
+    stats.evictions++;
+
+    return true;
+}
+
+void ResidencyManager::end_frame(uint64_t completed_frame)
+{
+    if (resident_bytes > budget) {
+        std::vector<Entry*> candidates;
+
+        for (Entry& entry : entries) {
+            if (entry.contents && entry.last_used <= completed_frame)
+                candidates.push_back(&entry);
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b) {
+            return a->last_used < b->last_used;
+        });
+
+        for (Entry* entry : candidates) {
+            if (resident_bytes <= budget)
+                break;
+
+            evict(*entry);
+        }
+    }
+
+    stats.resident_bytes = resident_bytes;
+    stats.resident_count = 0;
+
+    for (const Entry& entry : entries)
+        stats.resident_count += entry.contents != nullptr;
+
+    last_stats = stats;
+    stats = {};
+}
+
+void ResidencyManager::set_budget(uint64_t b)
+{
+    budget = b;
+}
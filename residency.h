@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "resource_manager.h"
+
+// Keeps GPU memory under a budget. Every resource records the frame it
+// was last used in; once the resident total exceeds the budget, the least
+// recently used resources the GPU is done with are written to a backing
+// file and released, and use() streams them back in on demand. Memory
+// comes from the allocate/release callbacks so the manager itself stays
+// backend independent.
+class ResidencyManager
+{
+public:
+    struct Callbacks {
+        // returns CPU visible contents of a new allocation, nullptr on failure
+        std::function<void*(ResourceHandle, uint64_t)> allocate;
+        std::function<void(ResourceHandle)> release;
+    };
+
+    struct FrameStats {
+        uint64_t resident_bytes;
+        uint32_t resident_count;
+        uint32_t evictions;
+        uint32_t reloads;
+        double reload_ms; // time spent stalled on reloads
+    };
+
+    // evicted resources go to a temporary file named after name, it is
+    // unlinked as soon as it is open
+    void init(const std::string& name, uint64_t budget, Callbacks callbacks);
+    // releases every resource and closes the backing file
+    void cleanup();
+
+    // allocates a resident resource, fill it through use()
+    ResourceHandle add(uint64_t size);
+    void remove(ResourceHandle handle);
+
+    // contents of the resource, reloaded from disk first if evicted,
+    // nullptr if it could not be
+    void* use(ResourceHandle handle, uint64_t frame);
+    bool resident(ResourceHandle handle);
+
+    // contents changed since last eviction and must be written again
+    void mark_dirty(ResourceHandle handle);
+
+    // evicts down to the budget among resources last used no later than
+    // completed_frame, then starts a new stats frame
+    void end_frame(uint64_t completed_frame);
+
+    void set_budget(uint64_t budget);
+    const FrameStats& last_frame_stats() const { return last_stats; }
+
+private:
+    static const uint64_t NOT_BACKED = UINT64_MAX;
+
+    struct Entry {
+        ResourceHandle handle;
+        uint64_t size;
+        uint64_t last_used;
+        uint64_t file_offset;
+        void* contents;
+        bool dirty;
+    };
+
+    bool evict(Entry& entry);
+
+    ResourcePool<Entry> entries;
+    Callbacks callbacks;
+    uint64_t budget = 0;
+    uint64_t resident_bytes = 0;
+
+    int backing_fd = -1;
+    uint64_t backing_end = 0;
+
+    FrameStats stats = {};
+    FrameStats last_stats = {};
+};
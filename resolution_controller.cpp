@@ -0,0 +1,62 @@
+#include "resolution_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+// below this fraction of the target there is room to scale up
+const double LOWER_BAND = 0.8;
+// changes aim this far under the target to land inside the band
+const double AIM = 0.9;
+// scaling up is gradual, a misjudged step up costs a slow frame
+const float MAX_STEP_UP = 1.1f;
+// scales are multiples of this so noise doesn't cause tiny changes
+const float SCALE_QUANTUM = 1.0f / 64.0f;
+
+void ResolutionController::init(double target, float lowest, float highest)
+{
+    target_ms = target;
+    min_scale = lowest;
+    max_scale = highest;
+    current_scale = highest;
+
+    window_total = 0.0;
+    window_next = 0;
+    window_count = 0;
+    change_count = 0;
+}
+
+float ResolutionController::update(double frame_ms)
+{
+    if (window_count == WINDOW)
+        window_total -= window[window_next];
+    else
+        window_count++;
+
+    window[window_next] = frame_ms;
+    window_total += frame_ms;
+    window_next = (window_next + 1) % WINDOW;
+
+    if (window_count < WINDOW)
+        return current_scale;
+
+    double average = window_total / WINDOW;
+
+    if (average <= target_ms && average >= target_ms * LOWER_BAND)
+        return current_scale;
+
+    float wanted = current_scale * (float)std::sqrt(target_ms * AIM / average);
+    wanted = std::min(wanted, current_scale * MAX_STEP_UP);
+    wanted = std::round(wanted / SCALE_QUANTUM) * SCALE_QUANTUM;
+    wanted = std::clamp(wanted, min_scale, max_scale);
+
+    if (wanted == current_scale)
+        return current_scale;
+
+    // frames so far were at the old scale
+    current_scale = wanted;
+    window_total = 0.0;
+    window_count = 0;
+    change_count++;
+
+    return current_scale;
+}
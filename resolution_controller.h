@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+// Picks the render resolution scale that holds a target frame time. Fill
+// cost goes with the pixel count, the square of the scale, so a change
+// aims at a frame time a little under the target. Nothing changes while
+// the recent average stays between LOWER_BAND * target and the target,
+// and after a change the next one waits for a full window of frames at
+// the new scale, so it doesn't oscillate.
+class ResolutionController
+{
+public:
+    void init(double target_ms, float min_scale = 0.5f, float max_scale = 1.0f);
+
+    // time of a frame rendered at scale(), returns the scale for the next
+    float update(double frame_ms);
+
+    float scale() const { return current_scale; }
+    double average_ms() const { return window_count ? window_total / window_count : 0.0; }
+    uint32_t changes() const { return change_count; }
+
+private:
+    static const int WINDOW = 8;
+
+    double target_ms = 0.0;
+    float min_scale = 1.0f;
+    float max_scale = 1.0f;
+    float current_scale = 1.0f;
+
+    double window[WINDOW] = {};
+    double window_total = 0.0;
+    int window_next = 0;
+    int window_count = 0;
+
+    uint32_t change_count = 0;
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// 32 bit handle: low 20 bits are the slot index, high 12 bits the slot
+// generation. Generations start at 1 so a zero handle is never valid.
+struct ResourceHandle {
+    static const uint32_t INDEX_BITS = 20;
+    static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+    uint32_t id;
+
+    uint32_t index() const { return id & INDEX_MASK; }
+    uint32_t generation() const { return id >> INDEX_BITS; }
+
+    bool operator==(const ResourceHandle& other) const { return id == other.id; }
+    bool operator!=(const ResourceHandle& other) const { return id != other.id; }
+};
+
+const ResourceHandle NULL_HANDLE = { 0 };
+
+// Values live in a dense array for iteration, slots map handles to dense
+// positions. Removal swaps the last value into the hole and bumps the
+// slot generation so stale handles stop resolving.
+template <typename T>
+class ResourcePool
+{
+public:
+    ResourceHandle create(const T& value)
+    {
+        uint32_t index;
+
+        if (free_head != INVALID) {
+            index = free_head;
+            free_head = slots[index].next_free;
+        }
+        else {
+            if (slots.size() > ResourceHandle::INDEX_MASK)
+                return NULL_HANDLE;
+
+            index = (uint32_t)slots.size();
+            slots.push_back({ INVALID, 1, INVALID });
+        }
+
+        Slot& slot = slots[index];
+        slot.dense = (uint32_t)dense.size();
+
+        dense.push_back(value);
+        dense_slot.push_back(index);
+
+        return { (slot.generation << ResourceHandle::INDEX_BITS) | index };
+    }
+
+    T* get(ResourceHandle handle)
+    {
+        uint32_t index = handle.index();
+
+        if (index >= slots.size())
+            return nullptr;
+
+        const Slot& slot = slots[index];
+
+        if (slot.dense == INVALID || slot.generation != handle.generation())
+            return nullptr;
+
+        return &dense[slot.dense];
+    }
+
+    const T* get(ResourceHandle handle) const
+    {
+        return const_cast<ResourcePool*>(this)->get(handle);
+    }
+
+    bool remove(ResourceHandle handle, T* out)
+    {
+        T* value = get(handle);
+
+        if (!value)
+            return false;
+
+        if (out)
+            *out = *value;
+
+        Slot& slot = slots[handle.index()];
+        uint32_t last = (uint32_t)dense.size() - 1;
+
+        if (slot.dense != last) {
+            dense[slot.dense] = dense[last];
+            dense_slot[slot.dense] = dense_slot[last];
+            slots[dense_slot[slot.dense]].dense = slot.dense;
+        }
+
+        dense.pop_back();
+        dense_slot.pop_back();
+
+        slot.dense = INVALID;
+        slot.generation = (slot.generation + 1) & ResourceHandle::GENERATION_MASK;
+        if (slot.generation == 0)
+            slot.generation = 1;
+
+        slot.next_free = free_head;
+        free_head = handle.index();
+
+        return true;
+    }
+
+    size_t size() const { return dense.size(); }
+
+    T* begin() { return dense.data(); }
+    T* end() { return dense.data() + dense.size(); }
+
+private:
+    static const uint32_t INVALID = 0xffffffff;
+
+    struct Slot {
+        uint32_t dense;
+        uint32_t generation;
+        uint32_t next_free;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<T> dense;
+    std::vector<uint32_t> dense_slot;
+    uint32_t free_head = INVALID;
+};
+
+// destroyer for reference counted objects like Metal's
+struct ReleaseObject {
+    template <typename T>
+    void operator()(T* object) { object->release(); }
+};
+
+// Pool plus a deferred destruction queue: destroy() invalidates the
+// handle right away, but the resource is only handed to Destroy once
+// collect() reports the frame that last used it has completed on the GPU.
+// Frames passed to destroy() must not decrease.
+template <typename T, typename Destroy>
+class ResourceManager
+{
+public:
+    ResourceHandle create(const T& value)
+    {
+        return pool.create(value);
+    }
+
+    T get(ResourceHandle handle) const
+    {
+        const T* value = pool.get(handle);
+
+        return value ? *value : T();
+    }
+
+    void destroy(ResourceHandle handle, uint64_t last_used_frame)
+    {
+        T value;
+
+        if (pool.remove(handle, &value))
+            pending.push_back({ last_used_frame, value });
+    }
+
+    void collect(uint64_t completed_frame)
+    {
+        while (!pending.empty() && pending.front().frame <= completed_frame) {
+            destroyer(pending.front().value);
+            pending.pop_front();
+        }
+    }
+
+    // destroys everything still queued, the GPU must be idle
+    void flush()
+    {
+        collect(UINT64_MAX);
+    }
+
+    size_t size() const { return pool.size(); }
+    size_t pending_count() const { return pending.size(); }
+
+    ResourcePool<T>& resources() { return pool; }
+
+private:
+    struct PendingDestroy {
+        uint64_t frame;
+        T value;
+    };
+
+    ResourcePool<T> pool;
+    std::deque<PendingDestroy> pending;
+    Destroy destroyer;
+};
@@ -0,0 +1,64 @@
+#include "scene.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "asset_cache.h"
+#include "meshlet.h"
+#include "simplify.h"
+
+const size_t MAX_LODS = 6;
+const float LOD_RATIO = 0.5f;
+const float LOD_COLOR_WEIGHT = 0.5f;
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+// bump when mesh processing output changes
+const uint32_t MESH_PROCESSING_VERSION = 1;
+
+Mesh scene_mesh()
+{
+    Mesh mesh;
+    mesh.vertices = {
+        {{  1.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }},
+        {{ -1.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }},
+        {{  0.0f,  1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }},
+    };
+    mesh.indices = { 0, 1, 2 };
+
+    return mesh;
+}
+
+ProcessedMesh process_mesh(const Mesh& mesh)
+{
+    ProcessedMesh out;
+    std::vector<MeshLod> lods;
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        lods = build_lod_chain(mesh, MAX_LODS, LOD_RATIO, LOD_COLOR_WEIGHT);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "lod chain: " << lods.size() << " levels from " << mesh.indices.size() / 3
+                  << " triangles in " << elapsed.count() * 1000 << " ms\n";
+    }
+
+    out.packed = pack_mesh(mesh.vertices, lods);
+    out.meshlets = build_meshlets(out.packed, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+
+    return out;
+}
+
+uint64_t processed_mesh_key(const Mesh& mesh)
+{
+    const float params[] = {
+        (float)MESH_PROCESSING_VERSION, (float)MAX_LODS, LOD_RATIO, LOD_COLOR_WEIGHT,
+        (float)MESHLET_MAX_VERTICES, (float)MESHLET_MAX_TRIANGLES,
+    };
+
+    uint64_t key = hash_bytes(params, sizeof(params), 0);
+    key = hash_bytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex), key);
+    key = hash_bytes(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), key);
+
+    return key;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+#include "mesh.h"
+#include "mesh_blob.h"
+
+// The mesh the app draws and how it is processed for rendering, shared
+// by the renderer and pack_assets, which bakes the result into mesh.blob
+// for builds made with EMBED=1.
+Mesh scene_mesh();
+
+// lod chain, packing and meshlets
+ProcessedMesh process_mesh(const Mesh& mesh);
+
+// asset cache key of mesh processed with the current parameters
+uint64_t processed_mesh_key(const Mesh& mesh);
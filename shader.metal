@@ -8,6 +8,12 @@ struct UBO
     float4x4 mvp;
 };
 
+struct MeshQuant
+{
+    float4 scale;
+    float4 offset;
+};
+
 struct VertexIn
 {
     float3 inPos [[attribute(0)]];
@@ -30,12 +36,14 @@ struct FragmentOut
     float4 outFragColor [[color(0)]];
 };
 
-vertex VertexOut VS(VertexIn in [[stage_in]], constant UBO& ubo [[buffer(1)]])
+vertex VertexOut VS(VertexIn in [[stage_in]], constant UBO& ubo [[buffer(1)]], constant MeshQuant& quant [[buffer(2)]])
 {
     VertexOut out = {};
 
+    float3 pos = in.inPos * quant.scale.xyz + quant.offset.xyz;
+
     out.outColor = in.inColor;
-    out.position = ubo.mvp * float4(in.inPos, 1.0);
+    out.position = ubo.mvp * float4(pos, 1.0);
 
     return out;
 }
@@ -48,3 +56,72 @@ fragment FragmentOut FS(FragmentIn in [[stage_in]])
 
     return out;
 }
+
+// upscales the scene, rendered to the top left of an offscreen target at
+// a reduced resolution, to the full drawable
+struct UpscaleParams
+{
+    float2 uv_scale;
+    float2 uv_max;
+};
+
+struct UpscaleOut
+{
+    float4 position [[position]];
+    float2 uv;
+};
+
+vertex UpscaleOut upscale_VS(uint id [[vertex_id]], constant UpscaleParams& params [[buffer(0)]])
+{
+    UpscaleOut out = {};
+
+    // one triangle covering the screen
+    float2 uv = float2((id << 1) & 2, id & 2);
+
+    out.position = float4(uv * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+    out.uv = uv * params.uv_scale;
+
+    return out;
+}
+
+fragment float4 upscale_FS(UpscaleOut in [[stage_in]], constant UpscaleParams& params [[buffer(0)]],
+                           texture2d<float> scene [[texture(0)]], sampler linear [[sampler(0)]])
+{
+    // keep the filter off texels outside the rendered region
+    return scene.sample(linear, min(in.uv, params.uv_max));
+}
+
+// several views in one draw, each with its own viewport and UBO. Vertex
+// amplification runs the view independent part of the shader once for
+// all views, instancing is the fallback where it isn't supported
+struct MultiViewOut
+{
+    float3 outColor [[user(locn0)]];
+    float4 position [[position]];
+    uint viewport [[viewport_array_index]];
+};
+
+static MultiViewOut multiview_vertex(VertexIn in, uint view, constant UBO* ubo, constant MeshQuant& quant)
+{
+    MultiViewOut out = {};
+
+    float3 pos = in.inPos * quant.scale.xyz + quant.offset.xyz;
+
+    out.outColor = in.inColor;
+    out.position = ubo[view].mvp * float4(pos, 1.0);
+    out.viewport = view;
+
+    return out;
+}
+
+vertex MultiViewOut VS_amplified(VertexIn in [[stage_in]], ushort view [[amplification_id]],
+                                 constant UBO* ubo [[buffer(1)]], constant MeshQuant& quant [[buffer(2)]])
+{
+    return multiview_vertex(in, view, ubo, quant);
+}
+
+vertex MultiViewOut VS_instanced(VertexIn in [[stage_in]], uint view [[instance_id]],
+                                 constant UBO* ubo [[buffer(1)]], constant MeshQuant& quant [[buffer(2)]])
+{
+    return multiview_vertex(in, view, ubo, quant);
+}
@@ -0,0 +1,369 @@
+#include "simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+const double BORDER_WEIGHT = 10.0;
+
+struct Quadric {
+    double a00, a01, a02, a03;
+    double a11, a12, a13;
+    double a22, a23;
+    double a33;
+    double w;
+};
+
+struct Collapse {
+    uint32_t from, to;
+    double cost;
+};
+
+static void add_plane(Quadric& q, const double* n, double d, double w)
+{
+    q.a00 += w * n[0] * n[0];
+    q.a01 += w * n[0] * n[1];
+    q.a02 += w * n[0] * n[2];
+    q.a03 += w * n[0] * d;
+    q.a11 += w * n[1] * n[1];
+    q.a12 += w * n[1] * n[2];
+    q.a13 += w * n[1] * d;
+    q.a22 += w * n[2] * n[2];
+    q.a23 += w * n[2] * d;
+    q.a33 += w * d * d;
+    q.w += w;
+}
+
+static void add_quadric(Quadric& q, const Quadric& r)
+{
+    q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02; q.a03 += r.a03;
+    q.a11 += r.a11; q.a12 += r.a12; q.a13 += r.a13;
+    q.a22 += r.a22; q.a23 += r.a23;
+    q.a33 += r.a33;
+    q.w += r.w;
+}
+
+static double eval_quadric(const Quadric& q, const float* p)
+{
+    double x = p[0], y = p[1], z = p[2];
+
+    return x * x * q.a00 + y * y * q.a11 + z * z * q.a22
+        + 2 * (x * y * q.a01 + x * z * q.a02 + y * z * q.a12)
+        + 2 * (x * q.a03 + y * q.a13 + z * q.a23)
+        + q.a33;
+}
+
+static void sub(const float* a, const float* b, double* out)
+{
+    for (int i = 0; i < 3; i++)
+        out[i] = (double)a[i] - b[i];
+}
+
+static void cross(const double* a, const double* b, double* out)
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static double dot(const double* a, const double* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void triangle_normal(const float* p0, const float* p1, const float* p2, double* n)
+{
+    double e0[3], e1[3];
+    sub(p1, p0, e0);
+    sub(p2, p0, e1);
+    cross(e0, e1, n);
+}
+
+static void build_quadrics(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                           std::vector<Quadric>& quadrics)
+{
+    quadrics.assign(vertices.size(), Quadric {});
+
+    // edges seen by a single triangle are borders
+    std::unordered_map<uint64_t, int> edge_count;
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint64_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+            edge_count[a < b ? (a << 32) | b : (b << 32) | a]++;
+        }
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const uint32_t* tri = &indices[i];
+        const float* p[3] = { vertices[tri[0]].position, vertices[tri[1]].position, vertices[tri[2]].position };
+
+        double n[3];
+        triangle_normal(p[0], p[1], p[2], n);
+
+        double len = std::sqrt(dot(n, n));
+        if (len == 0.0)
+            continue;
+
+        for (int k = 0; k < 3; k++)
+            n[k] /= len;
+
+        double area = len * 0.5;
+        double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+
+        for (int k = 0; k < 3; k++)
+            add_plane(quadrics[tri[k]], n, d, area);
+
+        // border edges get a plane perpendicular to the face to keep the
+        // outline in place
+        for (int k = 0; k < 3; k++) {
+            uint64_t a = tri[k], b = tri[(k + 1) % 3];
+            if (edge_count[a < b ? (a << 32) | b : (b << 32) | a] != 1)
+                continue;
+
+            double e[3], bn[3];
+            sub(p[(k + 1) % 3], p[k], e);
+            cross(e, n, bn);
+
+            double blen = std::sqrt(dot(bn, bn));
+            if (blen == 0.0)
+                continue;
+
+            for (int j = 0; j < 3; j++)
+                bn[j] /= blen;
+
+            double bd = -(bn[0] * p[k][0] + bn[1] * p[k][1] + bn[2] * p[k][2]);
+
+            add_plane(quadrics[a], bn, bd, dot(e, e) * BORDER_WEIGHT);
+            add_plane(quadrics[b], bn, bd, dot(e, e) * BORDER_WEIGHT);
+        }
+    }
+}
+
+static float mesh_radius(const std::vector<Vertex>& vertices)
+{
+    if (vertices.empty())
+        return 0.0f;
+
+    float lo[3], hi[3];
+    for (int i = 0; i < 3; i++)
+        lo[i] = hi[i] = vertices[0].position[i];
+
+    for (const Vertex& v : vertices) {
+        for (int i = 0; i < 3; i++) {
+            lo[i] = std::min(lo[i], v.position[i]);
+            hi[i] = std::max(hi[i], v.position[i]);
+        }
+    }
+
+    float d[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+
+    return 0.5f * std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+static double collapse_cost(const std::vector<Vertex>& vertices, const std::vector<Quadric>& quadrics,
+                            uint32_t from, uint32_t to, double color_scale)
+{
+    Quadric q = quadrics[from];
+    add_quadric(q, quadrics[to]);
+
+    double cost = q.w > 0 ? std::max(eval_quadric(q, vertices[to].position), 0.0) / q.w : 0.0;
+
+    double dc[3];
+    sub(vertices[from].color, vertices[to].color, dc);
+
+    return cost + color_scale * color_scale * dot(dc, dc);
+}
+
+// moving from onto to must not flip any triangle that survives, or turn
+// it far enough that a few collapses in a row could
+static bool collapse_flips(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                           const uint32_t* adjacency, size_t count, uint32_t from, uint32_t to)
+{
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t* tri = &indices[adjacency[i] * 3];
+
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+            continue;
+
+        const float* p[3];
+        const float* q[3];
+        for (int k = 0; k < 3; k++) {
+            p[k] = vertices[tri[k]].position;
+            q[k] = tri[k] == from ? vertices[to].position : p[k];
+        }
+
+        double before[3], after[3];
+        triangle_normal(p[0], p[1], p[2], before);
+        triangle_normal(q[0], q[1], q[2], after);
+
+        if (dot(before, after) <= 0.25 * std::sqrt(dot(before, before) * dot(after, after)))
+            return true;
+    }
+
+    return false;
+}
+
+std::vector<uint32_t> simplify_indices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                       size_t target_index_count, float color_weight, float* out_error)
+{
+    std::vector<uint32_t> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+    std::vector<Quadric> quadrics;
+    build_quadrics(vertices, result, quadrics);
+
+    double color_scale = (double)color_weight * mesh_radius(vertices);
+    double max_cost = 0.0;
+
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> adjacency_offset, adjacency;
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<uint8_t> locked(vertices.size());
+
+    while (result.size() > target_index_count) {
+        size_t triangle_count = result.size() / 3;
+        size_t target_triangles = target_index_count / 3;
+
+        // candidate edges, cheapest direction of each
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+                if (a > b)
+                    std::swap(a, b);
+
+                collapses.push_back({ a, b, 0.0 });
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) {
+            return l.from != r.from ? l.from < r.from : l.to < r.to;
+        });
+        collapses.erase(std::unique(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) {
+            return l.from == r.from && l.to == r.to;
+        }), collapses.end());
+
+        for (Collapse& c : collapses) {
+            double forward = collapse_cost(vertices, quadrics, c.from, c.to, color_scale);
+            double backward = collapse_cost(vertices, quadrics, c.to, c.from, color_scale);
+
+            if (backward < forward)
+                std::swap(c.from, c.to);
+
+            c.cost = std::min(forward, backward);
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) {
+            return l.cost < r.cost;
+        });
+
+        // vertex to triangle adjacency
+        adjacency_offset.assign(vertices.size() + 1, 0);
+        for (uint32_t v : result)
+            adjacency_offset[v + 1]++;
+        for (size_t v = 0; v < vertices.size(); v++)
+            adjacency_offset[v + 1] += adjacency_offset[v];
+
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+                adjacency[fill[result[i]]++] = (uint32_t)(i / 3);
+        }
+
+        for (size_t v = 0; v < vertices.size(); v++)
+            remap[v] = (uint32_t)v;
+        std::fill(locked.begin(), locked.end(), 0);
+
+        size_t removed = 0;
+
+        for (const Collapse& c : collapses) {
+            if (locked[c.from] || locked[c.to])
+                continue;
+
+            const uint32_t* adj = &adjacency[adjacency_offset[c.from]];
+            size_t adj_count = adjacency_offset[c.from + 1] - adjacency_offset[c.from];
+
+            if (collapse_flips(vertices, result, adj, adj_count, c.from, c.to))
+                continue;
+
+            remap[c.from] = c.to;
+            add_quadric(quadrics[c.to], quadrics[c.from]);
+            max_cost = std::max(max_cost, c.cost);
+
+            // lock the one ring so later collapses in this pass see
+            // up to date triangles
+            for (size_t i = 0; i < adj_count; i++) {
+                const uint32_t* tri = &result[adj[i] * 3];
+
+                removed += tri[0] == c.to || tri[1] == c.to || tri[2] == c.to;
+
+                for (int k = 0; k < 3; k++)
+                    locked[tri[k]] = 1;
+            }
+
+            if (triangle_count - removed <= target_triangles)
+                break;
+        }
+
+        if (removed == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+
+            if (a == b || b == c || a == c)
+                continue;
+
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (out_error)
+        *out_error = (float)std::sqrt(max_cost);
+
+    return result;
+}
+
+std::vector<MeshLod> build_lod_chain(const Mesh& mesh, size_t max_lods, float ratio, float color_weight)
+{
+    std::vector<MeshLod> lods = {{ mesh.indices, 0.0f }};
+
+    while (lods.size() < max_lods) {
+        const MeshLod& prev = lods.back();
+        size_t target = (size_t)(prev.indices.size() / 3 * ratio) * 3;
+
+        if (target < 3)
+            break;
+
+        float error;
+        std::vector<uint32_t> indices = simplify_indices(mesh.vertices, prev.indices, target, color_weight, &error);
+
+        // stop once the mesh can't be reduced meaningfully anymore
+        if (indices.empty() || indices.size() * 10 > prev.indices.size() * 9)
+            break;
+
+        float total_error = prev.error + error;
+        lods.push_back({ std::move(indices), total_error });
+    }
+
+    return lods;
+}
+
+size_t select_lod(const std::vector<PackedLod>& lods, float distance, float fov_y,
+                  float viewport_height, float max_pixel_error)
+{
+    float pixels_per_unit = viewport_height / (2.0f * std::tan(fov_y * 0.5f) * std::max(distance, 1e-4f));
+
+    size_t lod = 0;
+
+    for (size_t i = 1; i < lods.size(); i++) {
+        if (lods[i].error * pixels_per_unit <= max_pixel_error)
+            lod = i;
+    }
+
+    return lod;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Quadric error edge collapse. Vertices only ever collapse onto one of
+// their neighbours, so every lod keeps indexing the original vertices.
+// color_weight scales the color difference of a collapse relative to the
+// mesh radius.
+std::vector<uint32_t> simplify_indices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                       size_t target_index_count, float color_weight, float* out_error);
+
+// lods[0] is the full mesh, each next level has about ratio times the
+// triangles of the previous one
+std::vector<MeshLod> build_lod_chain(const Mesh& mesh, size_t max_lods, float ratio, float color_weight);
+
+// coarsest lod whose error projects to at most max_pixel_error pixels
+// at the given distance
+size_t select_lod(const std::vector<PackedLod>& lods, float distance, float fov_y,
+                  float viewport_height, float max_pixel_error);
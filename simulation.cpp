@@ -0,0 +1,97 @@
+#include "simulation.h"
+
+#include <algorithm>
+
+#include "asset_cache.h"
+
+uint32_t held_actions(InputManager& input, bool latest)
+{
+    auto down = [&input, latest](int k) { return latest ? input.is_down(k) : input.is_held(k); };
+    uint32_t held = 0;
+
+    if (down(KEY_UP))
+        held |= ACTION_FORWARD;
+    if (down(KEY_DOWN))
+        held |= ACTION_BACKWARD;
+    if (down(KEY_LEFT))
+        held |= ACTION_ROTATE_LEFT;
+    if (down(KEY_RIGHT))
+        held |= ACTION_ROTATE_RIGHT;
+
+    return held;
+}
+
+void simulate(SimState& state, uint32_t held, float dt)
+{
+    if (held & ACTION_FORWARD) {
+        state.camera.process_keyboard(CameraDirection::FORWARD, dt);
+    }
+
+    if (held & ACTION_BACKWARD) {
+        state.camera.process_keyboard(CameraDirection::BACKWARD, dt);
+    }
+
+    if (held & ACTION_ROTATE_LEFT) {
+        state.triangle.rotate.z += ROTATE_SPEED * dt;
+        state.triangle.dirty = true;
+    }
+    else if (held & ACTION_ROTATE_RIGHT) {
+        state.triangle.rotate.z -= ROTATE_SPEED * dt;
+        state.triangle.dirty = true;
+    }
+}
+
+void simulation_step(SimState& previous, SimState& current, uint32_t held)
+{
+    previous = current;
+    current.clear_dirty();
+    simulate(current, held, (float)SIM_TIMESTEP);
+}
+
+int fixed_steps(double& accumulator, double delta_time)
+{
+    // far behind after a stall, the missed steps are dropped
+    accumulator = std::min(accumulator + delta_time, SIM_TIMESTEP * SIM_MAX_CATCH_UP);
+
+    int steps = 0;
+    while (accumulator >= SIM_TIMESTEP) {
+        accumulator -= SIM_TIMESTEP;
+        steps++;
+    }
+
+    return steps;
+}
+
+FrameView frame_view(const SimState& state, size_t views)
+{
+    FrameView s;
+    const Camera& camera = state.camera;
+    const Model& triangle = state.triangle;
+
+    // camera relative, the camera is at the origin
+    glm::mat4 m = triangle.model_mat(camera.position());
+    glm::vec3 object_camera = glm::inverse(m) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    s.view_count = views;
+
+    for (size_t i = 0; i < s.view_count; i++) {
+        Camera turned = camera;
+        if (i > 0)
+            turned.set_yaw(camera.yaw() + glm::two_pi<float>() * i / s.view_count);
+
+        s.mvp[i] = turned.view_projection() * m;
+        s.object_camera[i] = object_camera;
+    }
+
+    float scale = glm::max(triangle.scale.x, glm::max(triangle.scale.y, triangle.scale.z));
+    s.lod_distance = (float)glm::length(camera.position() - triangle.translate) / scale;
+    s.fov_y = camera.zoom();
+
+    return s;
+}
+
+uint64_t hash_frame_view(const FrameView& view, uint64_t seed)
+{
+    uint64_t h = hash_bytes(&view.mvp[0][0][0], sizeof(float) * 16 * view.view_count, seed);
+
+    return hash_bytes(&view.lod_distance, sizeof(float), h);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/euler_angles.hpp>
+
+#include "camera.h"
+#include "input_manager.h"
+#include "render_types.h"
+
+// simulation runs at a fixed rate, rendering interpolates between ticks
+const double SIM_TIMESTEP = 1.0 / 120.0;
+// ticks the simulation may fall behind before it skips ahead
+const int SIM_MAX_CATCH_UP = 8;
+// radians per second
+const float ROTATE_SPEED = 3.0f;
+
+// held actions, sampled where input is polled and read by the simulation
+enum Action : uint32_t {
+    ACTION_FORWARD = 1 << 0,
+    ACTION_BACKWARD = 1 << 1,
+    ACTION_ROTATE_LEFT = 1 << 2,
+    ACTION_ROTATE_RIGHT = 1 << 3,
+};
+
+// what the simulation ticks, shared by the app and bench.cpp
+struct Model {
+    glm::dvec3 translate; // world space
+    glm::vec3 rotate;
+    glm::vec3 scale;
+    // set by whatever moves the model, the owner clears it
+    bool dirty = true;
+
+    // relative to origin, the camera's position when rendering
+    glm::mat4 model_mat(const glm::dvec3& origin) const
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        glm::mat4 rot = glm::eulerAngleZYX(rotate.z, rotate.y, rotate.x);
+        model = glm::translate(model, glm::vec3(translate - origin));
+        model *= rot;
+        model = glm::scale(model, scale);
+
+        return model;
+    }
+
+    Model interpolate(const Model& to, float t) const
+    {
+        return {
+            glm::mix(translate, to.translate, (double)t),
+            glm::mix(rotate, to.rotate, t),
+            glm::mix(scale, to.scale, t),
+        };
+    }
+};
+
+struct SimState {
+    Camera camera;
+    Model triangle;
+
+    SimState interpolate(const SimState& to, float t) const
+    {
+        return { camera.interpolate(to.camera, t), triangle.interpolate(to.triangle, t) };
+    }
+
+    bool dirty() const
+    {
+        return camera.dirty() || triangle.dirty;
+    }
+
+    void clear_dirty()
+    {
+        camera.clear_dirty();
+        triangle.dirty = false;
+    }
+};
+
+// everything the renderer needs for one frame
+struct FrameView {
+    glm::mat4 mvp[MAX_VIEWS];
+    glm::vec3 object_camera[MAX_VIEWS];
+    size_t view_count;
+    float lod_distance;
+    float fov_y;
+};
+
+// the model seen from state's camera, camera relative. with several
+// views, view i looks i / views of a turn to the right of the camera
+FrameView frame_view(const SimState& state, size_t views);
+
+// everything in a view the GPU sees, equal hashes mean equal frames
+uint64_t hash_frame_view(const FrameView& view, uint64_t seed);
+
+// actions of the keys held as of the last update(), or with latest as of
+// the last latch()
+uint32_t held_actions(InputManager& input, bool latest = false);
+
+// moves state by dt seconds of the held actions
+void simulate(SimState& state, uint32_t held, float dt);
+
+// advances current by one fixed step, previous gets the state before it.
+// the dirty flags of current tell whether this tick changed anything
+void simulation_step(SimState& previous, SimState& current, uint32_t held);
+
+// adds delta_time to accumulator and takes out the fixed steps now due,
+// the remainder is how far rendering is into the next step
+int fixed_steps(double& accumulator, double delta_time);
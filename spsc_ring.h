@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded single producer, single consumer queue. Capacity must be a
+// power of two. push() fails instead of blocking when full.
+template <typename T, size_t CAPACITY>
+class SpscRing
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+public:
+    bool push(const T& value)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+
+        if (h - tail.load(std::memory_order_acquire) >= CAPACITY)
+            return false;
+
+        items[h & (CAPACITY - 1)] = value;
+        head.store(h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+
+        value = items[t & (CAPACITY - 1)];
+        tail.store(t + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool empty() const
+    {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+
+private:
+    // separate cache lines so producer and consumer don't false share
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    T items[CAPACITY];
+};
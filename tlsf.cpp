@@ -0,0 +1,354 @@
+#include "tlsf.h"
+
+#include <algorithm>
+
+static uint32_t floor_log2(uint64_t v)
+{
+    return 63 - (uint32_t)__builtin_clzll(v);
+}
+
+static uint64_t align_up(uint64_t v, uint64_t alignment)
+{
+    return (v + alignment - 1) & ~(alignment - 1);
+}
+
+// size in granularity units to first/second level indices
+static void mapping(uint64_t units, uint32_t sl_bits, uint32_t& fl, uint32_t& sl)
+{
+    if (units < (1ull << sl_bits)) {
+        fl = 0;
+        sl = (uint32_t)units;
+        return;
+    }
+
+    uint32_t log2 = floor_log2(units);
+    sl = (uint32_t)(units >> (log2 - sl_bits)) ^ (1u << sl_bits);
+    fl = log2 - sl_bits + 1;
+}
+
+// a search for units of space only looks at lists whose blocks are all
+// at least that large
+static uint64_t round_up_units(uint64_t units, uint32_t sl_bits)
+{
+    if (units >= (1ull << sl_bits))
+        units += (1ull << (floor_log2(units) - sl_bits)) - 1;
+
+    return units;
+}
+
+Tlsf::Tlsf(uint64_t size)
+    : total_size(size & ~(GRANULARITY - 1))
+    , first_block(NO_BLOCK)
+    , fl_bitmap(0)
+{
+    std::fill(sl_bitmap, sl_bitmap + FL_COUNT, 0u);
+    std::fill(&heads[0][0], &heads[0][0] + FL_COUNT * SL_COUNT, NO_BLOCK);
+
+    if (total_size == 0)
+        return;
+
+    first_block = new_block();
+    Block& b = blocks[first_block];
+    b.offset = 0;
+    b.size = total_size;
+    insert_free(first_block);
+}
+
+uint32_t Tlsf::new_block()
+{
+    uint32_t block;
+
+    if (!unused_blocks.empty()) {
+        block = unused_blocks.back();
+        unused_blocks.pop_back();
+    }
+    else {
+        block = (uint32_t)blocks.size();
+        blocks.emplace_back();
+    }
+
+    blocks[block] = { 0, 0, GRANULARITY, NO_BLOCK, NO_BLOCK, NO_BLOCK, NO_BLOCK, false };
+
+    return block;
+}
+
+void Tlsf::release_block(uint32_t block)
+{
+    unused_blocks.push_back(block);
+}
+
+void Tlsf::insert_free(uint32_t block)
+{
+    Block& b = blocks[block];
+    uint32_t fl, sl;
+    mapping(b.size / GRANULARITY, SL_BITS, fl, sl);
+
+    b.free = true;
+    b.prev_free = NO_BLOCK;
+    b.next_free = heads[fl][sl];
+
+    if (b.next_free != NO_BLOCK)
+        blocks[b.next_free].prev_free = block;
+
+    heads[fl][sl] = block;
+    fl_bitmap |= 1ull << fl;
+    sl_bitmap[fl] |= 1u << sl;
+}
+
+void Tlsf::remove_free(uint32_t block)
+{
+    Block& b = blocks[block];
+    uint32_t fl, sl;
+    mapping(b.size / GRANULARITY, SL_BITS, fl, sl);
+
+    if (b.prev_free != NO_BLOCK)
+        blocks[b.prev_free].next_free = b.next_free;
+    else
+        heads[fl][sl] = b.next_free;
+
+    if (b.next_free != NO_BLOCK)
+        blocks[b.next_free].prev_free = b.prev_free;
+
+    if (heads[fl][sl] == NO_BLOCK) {
+        sl_bitmap[fl] &= ~(1u << sl);
+        if (sl_bitmap[fl] == 0)
+            fl_bitmap &= ~(1ull << fl);
+    }
+
+    b.free = false;
+    b.prev_free = b.next_free = NO_BLOCK;
+}
+
+uint32_t Tlsf::find_free(uint64_t size)
+{
+    // round up to the next list so any block found is large enough
+    uint64_t units = round_up_units(size / GRANULARITY, SL_BITS);
+
+    uint32_t fl, sl;
+    mapping(units, SL_BITS, fl, sl);
+
+    if (fl >= FL_COUNT)
+        return NO_BLOCK;
+
+    uint32_t sl_map = sl < 32 ? sl_bitmap[fl] & (~0u << sl) : 0;
+
+    if (!sl_map) {
+        uint64_t fl_map = fl + 1 < 64 ? fl_bitmap & (~0ull << (fl + 1)) : 0;
+        if (!fl_map)
+            return NO_BLOCK;
+
+        fl = (uint32_t)__builtin_ctzll(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+
+    sl = (uint32_t)__builtin_ctz(sl_map);
+
+    return heads[fl][sl];
+}
+
+// worst case padding to reach the alignment included
+static uint64_t search_size(uint64_t size, uint64_t alignment)
+{
+    return align_up(std::max(size, (uint64_t)1), Tlsf::GRANULARITY) + alignment - Tlsf::GRANULARITY;
+}
+
+uint64_t Tlsf::capacity_for(uint64_t size, uint64_t alignment)
+{
+    uint64_t units = round_up_units(search_size(size, std::max(alignment, GRANULARITY)) / GRANULARITY, SL_BITS);
+
+    // the first size of the list the search lands in
+    if (units >= (1ull << SL_BITS)) {
+        uint32_t shift = floor_log2(units) - SL_BITS;
+        units = units >> shift << shift;
+    }
+
+    return units * GRANULARITY;
+}
+
+bool Tlsf::allocate(uint64_t size, uint64_t alignment, Allocation& out)
+{
+    alignment = std::max(alignment, GRANULARITY);
+    uint64_t search = search_size(size, alignment);
+    size = align_up(std::max(size, (uint64_t)1), GRANULARITY);
+
+    uint32_t block = find_free(search);
+    if (block == NO_BLOCK)
+        return false;
+
+    remove_free(block);
+
+    uint64_t aligned = align_up(blocks[block].offset, alignment);
+    uint64_t pad = aligned - blocks[block].offset;
+
+    // the physical neighbours of a free block are never free, so the
+    // split off parts don't need merging
+    if (pad > 0) {
+        uint32_t front = new_block();
+        Block& f = blocks[front];
+        Block& b = blocks[block];
+
+        f.offset = b.offset;
+        f.size = pad;
+        f.prev_phys = b.prev_phys;
+        f.next_phys = block;
+
+        if (f.prev_phys != NO_BLOCK)
+            blocks[f.prev_phys].next_phys = front;
+        else
+            first_block = front;
+
+        b.prev_phys = front;
+        b.offset = aligned;
+        b.size -= pad;
+
+        insert_free(front);
+    }
+
+    if (blocks[block].size - size >= GRANULARITY) {
+        uint32_t tail = new_block();
+        Block& t = blocks[tail];
+        Block& b = blocks[block];
+
+        t.offset = b.offset + size;
+        t.size = b.size - size;
+        t.prev_phys = block;
+        t.next_phys = b.next_phys;
+
+        if (t.next_phys != NO_BLOCK)
+            blocks[t.next_phys].prev_phys = tail;
+
+        b.next_phys = tail;
+        b.size = size;
+
+        insert_free(tail);
+    }
+
+    Block& b = blocks[block];
+    b.alignment = alignment;
+
+    out = { block, b.offset, b.size };
+
+    return true;
+}
+
+void Tlsf::free(uint32_t block)
+{
+    uint32_t next = blocks[block].next_phys;
+
+    if (next != NO_BLOCK && blocks[next].free) {
+        remove_free(next);
+
+        Block& b = blocks[block];
+        b.size += blocks[next].size;
+        b.next_phys = blocks[next].next_phys;
+
+        if (b.next_phys != NO_BLOCK)
+            blocks[b.next_phys].prev_phys = block;
+
+        release_block(next);
+    }
+
+    uint32_t prev = blocks[block].prev_phys;
+
+    if (prev != NO_BLOCK && blocks[prev].free) {
+        remove_free(prev);
+
+        Block& p = blocks[prev];
+        p.size += blocks[block].size;
+        p.next_phys = blocks[block].next_phys;
+
+        if (p.next_phys != NO_BLOCK)
+            blocks[p.next_phys].prev_phys = prev;
+
+        release_block(block);
+        block = prev;
+    }
+
+    insert_free(block);
+}
+
+uint64_t Tlsf::offset(uint32_t block) const
+{
+    return blocks[block].offset;
+}
+
+Tlsf::Stats Tlsf::stats() const
+{
+    Stats s = { total_size, 0, 0, 0, 0, 0, 0.0f };
+
+    for (uint32_t b = first_block; b != NO_BLOCK; b = blocks[b].next_phys) {
+        if (blocks[b].free) {
+            s.free += blocks[b].size;
+            s.largest_free = std::max(s.largest_free, blocks[b].size);
+            s.free_blocks++;
+        }
+        else {
+            s.used += blocks[b].size;
+            s.allocations++;
+        }
+    }
+
+    s.fragmentation = s.free > 0 ? 1.0f - (float)s.largest_free / (float)s.free : 0.0f;
+
+    return s;
+}
+
+std::vector<Tlsf::Move> Tlsf::compact()
+{
+    std::vector<Move> moves;
+    std::vector<uint32_t> used;
+
+    for (uint32_t b = first_block; b != NO_BLOCK; b = blocks[b].next_phys) {
+        if (blocks[b].free) {
+            remove_free(b);
+            release_block(b);
+        }
+        else {
+            used.push_back(b);
+        }
+    }
+
+    first_block = NO_BLOCK;
+    uint32_t last = NO_BLOCK;
+    uint64_t cursor = 0;
+
+    auto link = [&](uint32_t b) {
+        blocks[b].prev_phys = last;
+        blocks[b].next_phys = NO_BLOCK;
+
+        if (last != NO_BLOCK)
+            blocks[last].next_phys = b;
+        else
+            first_block = b;
+
+        last = b;
+    };
+
+    auto add_free = [&](uint64_t offset, uint64_t size) {
+        uint32_t f = new_block();
+        blocks[f].offset = offset;
+        blocks[f].size = size;
+        link(f);
+        insert_free(f);
+    };
+
+    for (uint32_t b : used) {
+        uint64_t to = align_up(cursor, blocks[b].alignment);
+
+        if (to > cursor)
+            add_free(cursor, to - cursor);
+
+        if (to != blocks[b].offset) {
+            moves.push_back({ b, blocks[b].offset, to, blocks[b].size });
+            blocks[b].offset = to;
+        }
+
+        link(b);
+        cursor = to + blocks[b].size;
+    }
+
+    if (cursor < total_size)
+        add_free(cursor, total_size - cursor);
+
+    return moves;
+}
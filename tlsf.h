@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Two level segregated fit allocator over an abstract [0, size) range,
+// used to place many small buffers inside a few large GPU buffers. Block
+// headers are kept on the CPU side so the managed memory is never
+// touched. Allocation and free are O(1).
+class Tlsf
+{
+public:
+    static constexpr uint32_t NO_BLOCK = 0xffffffff;
+    static constexpr uint64_t GRANULARITY = 16;
+
+    struct Allocation {
+        uint32_t block;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct Stats {
+        uint64_t size;
+        uint64_t used;
+        uint64_t free;
+        uint64_t largest_free;
+        uint32_t allocations;
+        uint32_t free_blocks;
+        // 1 - largest_free / free, 0 when all free space is contiguous
+        float fragmentation;
+    };
+
+    // offsets of block moved from to to, apply in order
+    struct Move {
+        uint32_t block;
+        uint64_t from;
+        uint64_t to;
+        uint64_t size;
+    };
+
+    explicit Tlsf(uint64_t size);
+
+    // smallest range an empty Tlsf can serve allocate(size, alignment) from,
+    // searches round up to the next size class
+    static uint64_t capacity_for(uint64_t size, uint64_t alignment);
+
+    // alignment must be a power of two
+    bool allocate(uint64_t size, uint64_t alignment, Allocation& out);
+    void free(uint32_t block);
+
+    uint64_t offset(uint32_t block) const;
+    Stats stats() const;
+
+    // slides every allocation down to the start of the range, blocks keep
+    // their ids. the caller copies the data for each move
+    std::vector<Move> compact();
+
+private:
+    static constexpr uint32_t SL_BITS = 5;
+    static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+    static constexpr uint32_t FL_COUNT = 64 - SL_BITS;
+
+    struct Block {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t alignment;
+        uint32_t prev_phys, next_phys;
+        uint32_t prev_free, next_free;
+        bool free;
+    };
+
+    uint32_t new_block();
+    void release_block(uint32_t block);
+
+    void insert_free(uint32_t block);
+    void remove_free(uint32_t block);
+    uint32_t find_free(uint64_t size);
+
+    uint64_t total_size;
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unused_blocks;
+    uint32_t first_block;
+
+    uint64_t fl_bitmap;
+    uint32_t sl_bitmap[FL_COUNT];
+    uint32_t heads[FL_COUNT][SL_COUNT];
+};
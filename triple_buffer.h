@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer handoff of the latest value. The
+// producer fills write_buffer() and publishes it, the consumer picks up
+// the newest published value with update(). Neither side ever blocks,
+// values the consumer missed are simply overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+    T& write_buffer() { return buffers[back]; }
+
+    void publish()
+    {
+        uint32_t previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+    }
+
+    // true when a newer value than the current read_buffer() was taken
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+
+        uint32_t previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+
+        return true;
+    }
+
+    const T& read_buffer() const { return buffers[front]; }
+
+private:
+    static const uint32_t INDEX_MASK = 3;
+    static const uint32_t FRESH = 4;
+
+    T buffers[3] = {};
+    uint32_t back = 0;
+    std::atomic<uint32_t> middle{1};
+    uint32_t front = 2;
+};
@@ -0,0 +1,77 @@
+#include "vertex_format.h"
+
+uint16_t float_to_half(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exp = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+
+    if (exp <= 0) {
+        if (exp < -10)
+            return (uint16_t)sign;
+
+        mant |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exp);
+        uint32_t half = mant >> shift;
+        // round to nearest
+        half += (mant >> (shift - 1)) & 1;
+
+        return (uint16_t)(sign | half);
+    }
+
+    if (exp >= 31)
+        return (uint16_t)(sign | 0x7c00);
+
+    uint32_t half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+    half += (mant >> 12) & 1;
+
+    return (uint16_t)half;
+}
+
+float half_to_float(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+
+    if (exp == 0) {
+        float f = std::ldexp((float)mant, -24);
+        return sign ? -f : f;
+    }
+
+    uint32_t x = sign | (exp == 31 ? 0x7f800000 : (exp + 127 - 15) << 23) | (mant << 13);
+
+    float f;
+    memcpy(&f, &x, sizeof(f));
+
+    return f;
+}
+
+PositionTransform position_transform(const std::vector<Vertex>& vertices, bool normalized)
+{
+    PositionTransform t = {{ 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 0.0f }};
+
+    if (!normalized || vertices.empty())
+        return t;
+
+    float lo[3], hi[3];
+    memcpy(lo, vertices[0].position, sizeof(lo));
+    memcpy(hi, vertices[0].position, sizeof(hi));
+
+    for (const Vertex& v : vertices) {
+        for (int i = 0; i < 3; i++) {
+            lo[i] = std::min(lo[i], v.position[i]);
+            hi[i] = std::max(hi[i], v.position[i]);
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        t.offset[i] = (lo[i] + hi[i]) * 0.5f;
+        t.scale[i] = std::max((hi[i] - lo[i]) * 0.5f, 1e-20f);
+    }
+
+    return t;
+}
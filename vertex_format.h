@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "mesh.h"
+
+enum class VertexFormat {
+    Float3,
+    Half4,
+    Short4Normalized,
+    UChar4Normalized,
+};
+
+struct VertexAttribute {
+    VertexFormat format;
+    uint32_t offset;
+};
+
+// runtime view of a layout, used to build the Metal vertex descriptor
+struct VertexLayout {
+    VertexAttribute position; // attributes 0
+    VertexAttribute color;    // attributes 1
+    uint32_t stride;
+};
+
+// object space position = stored position * scale + offset,
+// same layout as MeshQuant in shader.metal
+struct PositionTransform {
+    float scale[4];
+    float offset[4];
+};
+
+struct QuantizedVertices {
+    VertexLayout layout;
+    PositionTransform transform;
+    size_t count;
+    std::vector<uint8_t> data;
+};
+
+uint16_t float_to_half(float f);
+float half_to_float(uint16_t h);
+
+template <VertexFormat F>
+struct FormatTraits;
+
+template <>
+struct FormatTraits<VertexFormat::Float3> {
+    static constexpr uint32_t size = sizeof(float) * 3;
+    static constexpr bool normalized = false;
+
+    static void encode(const float* v, uint8_t* dst)
+    {
+        memcpy(dst, v, sizeof(float) * 3);
+    }
+
+    static void decode(const uint8_t* src, float* v)
+    {
+        memcpy(v, src, sizeof(float) * 3);
+    }
+};
+
+template <>
+struct FormatTraits<VertexFormat::Half4> {
+    static constexpr uint32_t size = sizeof(uint16_t) * 4;
+    static constexpr bool normalized = true;
+
+    static void encode(const float* v, uint8_t* dst)
+    {
+        uint16_t h[4] = { float_to_half(v[0]), float_to_half(v[1]), float_to_half(v[2]), float_to_half(1.0f) };
+        memcpy(dst, h, sizeof(h));
+    }
+
+    static void decode(const uint8_t* src, float* v)
+    {
+        uint16_t h[3];
+        memcpy(h, src, sizeof(h));
+        for (int i = 0; i < 3; i++)
+            v[i] = half_to_float(h[i]);
+    }
+};
+
+template <>
+struct FormatTraits<VertexFormat::Short4Normalized> {
+    static constexpr uint32_t size = sizeof(int16_t) * 4;
+    static constexpr bool normalized = true;
+
+    static void encode(const float* v, uint8_t* dst)
+    {
+        int16_t s[4];
+        for (int i = 0; i < 3; i++)
+            s[i] = (int16_t)std::lround(std::clamp(v[i], -1.0f, 1.0f) * 32767.0f);
+        s[3] = 32767;
+        memcpy(dst, s, sizeof(s));
+    }
+
+    static void decode(const uint8_t* src, float* v)
+    {
+        int16_t s[3];
+        memcpy(s, src, sizeof(s));
+        // same rule as Metal: -32768 and -32767 both map to -1
+        for (int i = 0; i < 3; i++)
+            v[i] = std::max(s[i] / 32767.0f, -1.0f);
+    }
+};
+
+template <>
+struct FormatTraits<VertexFormat::UChar4Normalized> {
+    static constexpr uint32_t size = sizeof(uint8_t) * 4;
+    static constexpr bool normalized = true;
+
+    static void encode(const float* v, uint8_t* dst)
+    {
+        for (int i = 0; i < 3; i++)
+            dst[i] = (uint8_t)std::lround(std::clamp(v[i], 0.0f, 1.0f) * 255.0f);
+        dst[3] = 255;
+    }
+
+    static void decode(const uint8_t* src, float* v)
+    {
+        for (int i = 0; i < 3; i++)
+            v[i] = src[i] / 255.0f;
+    }
+};
+
+// Compile time vertex layout: offsets, stride, the descriptor view and the
+// fetch/encode functions are all derived from the two formats, so adding a
+// format never adds a branch to the per vertex loops.
+template <VertexFormat PositionFormat, VertexFormat ColorFormat>
+struct VertexLayoutOf {
+    using Position = FormatTraits<PositionFormat>;
+    using Color = FormatTraits<ColorFormat>;
+
+    static constexpr uint32_t position_offset = 0;
+    static constexpr uint32_t color_offset = Position::size;
+    static constexpr uint32_t stride = (color_offset + Color::size + 3) & ~3u;
+
+    static constexpr VertexLayout layout()
+    {
+        return {{ PositionFormat, position_offset }, { ColorFormat, color_offset }, stride };
+    }
+
+    static void encode(const Vertex& v, const PositionTransform& t, uint8_t* dst)
+    {
+        float p[3];
+        for (int k = 0; k < 3; k++)
+            p[k] = (v.position[k] - t.offset[k]) / t.scale[k];
+
+        Position::encode(p, dst + position_offset);
+        Color::encode(v.color, dst + color_offset);
+    }
+
+    static void fetch(const uint8_t* data, size_t index, const PositionTransform& t, Vertex& out)
+    {
+        const uint8_t* src = data + index * stride;
+
+        Position::decode(src + position_offset, out.position);
+        Color::decode(src + color_offset, out.color);
+
+        for (int k = 0; k < 3; k++)
+            out.position[k] = out.position[k] * t.scale[k] + t.offset[k];
+    }
+};
+
+using FloatVertexLayout = VertexLayoutOf<VertexFormat::Float3, VertexFormat::Float3>;
+
+static_assert(FloatVertexLayout::stride == sizeof(Vertex), "Vertex does not match its layout");
+static_assert(FloatVertexLayout::color_offset == offsetof(Vertex, color), "Vertex does not match its layout");
+
+// normalized and half positions are remapped to the mesh bounds
+PositionTransform position_transform(const std::vector<Vertex>& vertices, bool normalized);
+
+template <typename Layout>
+QuantizedVertices quantize_vertices(const std::vector<Vertex>& vertices)
+{
+    QuantizedVertices out;
+    out.layout = Layout::layout();
+    out.transform = position_transform(vertices, Layout::Position::normalized);
+    out.count = vertices.size();
+    out.data.resize(vertices.size() * Layout::stride);
+
+    for (size_t i = 0; i < vertices.size(); i++)
+        Layout::encode(vertices[i], out.transform, out.data.data() + i * Layout::stride);
+
+    return out;
+}
+
+// decoded vertices per second over the whole buffer
+template <typename Layout>
+double measure_vertex_decode(const QuantizedVertices& vertices, int iterations)
+{
+    Vertex v;
+    float sink = 0.0f;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (size_t i = 0; i < vertices.count; i++) {
+            Layout::fetch(vertices.data.data(), i, vertices.transform, v);
+            sink += v.position[0];
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    volatile float keep = sink;
+    (void)keep;
+
+    return elapsed.count() > 0 ? (double)vertices.count * iterations / elapsed.count() : 0;
+}